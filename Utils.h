@@ -2,9 +2,35 @@
 #ifndef SORTED_UTILS_H
 #define SORTED_UTILS_H
 
+#include <cassert>
+#include <cstdlib>
 #include <stdexcept>
 
+/**
+ * What Assert does on failure, chosen at compile time by defining SORTED_ASSERT_POLICY
+ * SORTED_ASSERT_THROW: throws std::runtime_error (default)
+ * SORTED_ASSERT_ABORT: aborts, so no exception can escape
+ * SORTED_ASSERT_DEBUG: checks with assert(), i.e. not at all when NDEBUG is defined
+ */
+#define SORTED_ASSERT_THROW 0
+#define SORTED_ASSERT_ABORT 1
+#define SORTED_ASSERT_DEBUG 2
+
+#ifndef SORTED_ASSERT_POLICY
+#define SORTED_ASSERT_POLICY SORTED_ASSERT_THROW
+#endif
+
+#if SORTED_ASSERT_POLICY == SORTED_ASSERT_THROW
+#define Assert(x) \
+    do { if (!(x)) throw std::runtime_error(""); } while (0)
+#elif SORTED_ASSERT_POLICY == SORTED_ASSERT_ABORT
+#define Assert(x) \
+    do { if (!(x)) std::abort(); } while (0)
+#elif SORTED_ASSERT_POLICY == SORTED_ASSERT_DEBUG
 #define Assert(x) \
-    if (!(x)) throw std::runtime_error("")
+    assert(x)
+#else
+#error "unknown SORTED_ASSERT_POLICY"
+#endif
 
 #endif //SORTED_UTILS_H
@@ -0,0 +1,275 @@
+#ifndef HARA_ADAPTIVE_SORTED_H
+#define HARA_ADAPTIVE_SORTED_H
+
+#include <cmath>
+#include <functional>
+#include <optional>
+#include "priority_queue_impl.h"
+
+enum class AdaptiveLayout {
+    Heap,   // HeapLayout, for pop-heavy loads
+    Set,    // SetLayout, for updates that would pile stale copies up in the heap
+    Scan,   // ScanLayout, for update-only bursts
+};
+
+struct MigrationEvent {
+    enum Phase {
+        Started,
+        Finished,
+    };
+
+    Phase phase;
+    AdaptiveLayout from;
+    AdaptiveLayout to;
+    size_t size;
+};
+
+/**
+ * Backend that samples its operation mix and migrates online to the cheapest layout.
+ *
+ * Every Window operations, the cost of the last window is estimated for each layout:
+ * Heap (inserts + 2 * updates + pops) * lg(N), as each update leaves a stale copy to pop later
+ * Scan inserts + updates + pops * N, as each pop rescans the index
+ * Set  is chosen over Heap when updates outnumber pops MaxStaleRatio to one,
+ *      or when the heap actually holds MaxStaleRatio stale copies per pair
+ * A layout must win two windows in a row before a migration starts.
+ *
+ * A migration copies the index into the new layout in key order, Budget pairs per update,
+ * while the old layout keeps serving; updates to pairs copied already go to both.
+ * The old layout is then drained at the same pace, so no single call pays for the whole migration.
+ * @tparam K
+ * @tparam V
+ * @tparam Index an ordered index such as OrderedIndex, as the migration copies the pairs in key order
+ * @tparam Allocator rebound for the index and all three layouts
+ */
+template<typename K, typename V, typename Compare = std::less<V>, size_t Window = 4096, size_t Budget = 64,
+        typename Index = OrderedIndex, typename Allocator = std::allocator<std::pair<const K, V>>>
+class AdaptiveSorted : public IndexedImpl<K, V, Compare, Index, Allocator> {
+    using Base = IndexedImpl<K, V, Compare, Index, Allocator>;
+    using typename Base::Pair;
+    using typename Base::PairAllocator;
+    using Base::valid;
+
+public:
+    static constexpr size_t MaxStaleRatio = 4;
+
+    explicit AdaptiveSorted(const Allocator &allocator = Allocator())
+            : Base{allocator}, allocator{allocator}, heap{this->allocator}, set{this->allocator}, scan{this->allocator} {}
+
+    /**
+     * Bulk load into a heap: deduplicates keys according to policy and sorts on all cores
+     * Complexity: O(N lg(N) / P + N)
+     */
+    template<typename Iterator>
+    explicit AdaptiveSorted(Iterator begin, Iterator end, DuplicatePolicy policy = DuplicatePolicy::LastWins,
+                            const Allocator &allocator = Allocator())
+            : AdaptiveSorted{allocator} {
+        heap.Build(this->Load(begin, end, policy));
+    }
+
+    ~AdaptiveSorted() override = default;
+
+    /**
+     * Complexity: see AdaptiveLayout
+     * @return nullptr if empty
+     */
+    const std::pair<K, V> *TryTop() const override {
+        const Pair *top = nullptr;
+        With(current, [&](const auto &storage) { top = storage.Top(valid); });
+        return top ? &top->x : nullptr;
+    }
+
+    void Pop() override {
+        auto top = TryTop();
+        if (!top) return;
+        ++stats.pops;
+
+        auto it = valid.find(top->first);
+        if (Migrated(it->first)) With(*target, [&](auto &storage) { storage.Removed(*it); });
+        valid.erase(it);
+        With(current, [](auto &storage) { storage.Pop(); });
+        Settle();
+        Step();
+    }
+
+    void InsertOrUpdate(std::pair<K, V> pair) override {
+        auto it = valid.find(pair.first);
+        const bool migrated = Migrated(pair.first);
+        if (it == valid.end()) {
+            ++stats.inserts;
+            valid.insert(pair);
+        } else {
+            ++stats.updates;
+            With(current, [&](auto &storage) { storage.Removed(*it); });
+            if (migrated) With(*target, [&](auto &storage) { storage.Removed(*it); });
+            it->second = pair.second;
+        }
+        if (migrated) With(*target, [&](auto &storage) { storage.Inserted(Pair{pair}); });
+        With(current, [&](auto &storage) { storage.Inserted(Pair{std::move(pair)}); });
+        Settle();
+        Step();
+    }
+
+    void Erase(const K &key) override {
+        auto it = valid.find(key);
+        if (it == valid.end()) return;
+        ++stats.updates;
+
+        With(current, [&](auto &storage) { storage.Removed(*it); });
+        if (Migrated(key)) With(*target, [&](auto &storage) { storage.Removed(*it); });
+        valid.erase(it);
+        Settle();
+        Step();
+    }
+
+    AdaptiveLayout Layout() const { return current; }
+
+    /**
+     * Whether a migration is under way, or waiting to start
+     */
+    bool Migrating() const { return target || pending; }
+
+    /**
+     * Starts migrating to layout, whatever the workload; it proceeds with the following updates.
+     * If layout is still being drained since the last migration, it starts once the drain is over,
+     * so that no single call pays for the whole drain
+     */
+    void Migrate(AdaptiveLayout layout) {
+        if (target || pending || layout == current) return;
+        if (retired && *retired == layout) pending = layout;
+        else Start(layout);
+    }
+
+    /**
+     * Called on every migration event, e.g. for monitoring
+     */
+    void OnMigration(std::function<void(const MigrationEvent &)> callback) { listener = std::move(callback); }
+
+private:
+    struct Stats {
+        size_t inserts = 0;
+        size_t updates = 0;
+        size_t pops = 0;
+    };
+
+    template<typename F>
+    void With(AdaptiveLayout layout, F &&f) {
+        switch (layout) {
+            case AdaptiveLayout::Heap: f(heap); break;
+            case AdaptiveLayout::Set: f(set); break;
+            case AdaptiveLayout::Scan: f(scan); break;
+        }
+    }
+
+    template<typename F>
+    void With(AdaptiveLayout layout, F &&f) const {
+        switch (layout) {
+            case AdaptiveLayout::Heap: f(heap); break;
+            case AdaptiveLayout::Set: f(set); break;
+            case AdaptiveLayout::Scan: f(scan); break;
+        }
+    }
+
+    /**
+     * Whether key is in the target layout already
+     */
+    bool Migrated(const K &key) const { return target && cursor && !(*cursor < key); }
+
+    /**
+     * The target is only settled once the copy is complete, as it holds just the migrated keys until then
+     */
+    void Settle() { With(current, [&](auto &storage) { storage.Settle(valid); }); }
+
+    void Start(AdaptiveLayout layout) {
+        pending.reset();
+        target = layout;
+        cursor.reset();
+        Notify(MigrationEvent::Started);
+    }
+
+    /**
+     * Bounded amount of background work, done after every update
+     */
+    void Step() {
+        if (retired) Drain();
+        if (pending && !retired) Start(*pending);
+        if (target) Copy();
+        else if (++sampled == Window) Sample();
+    }
+
+    void Copy() {
+        auto it = cursor ? valid.upper_bound(*cursor) : valid.begin();
+        With(*target, [&](auto &storage) {
+            for (size_t i = 0; i < Budget && it != valid.end(); ++i, ++it) {
+                storage.Inserted(Pair{*it});
+                cursor = it->first;
+            }
+            if (it == valid.end()) storage.Settle(valid);
+        });
+        if (it != valid.end()) return;
+
+        // the target is complete: swap, and drain the old layout from now on
+        retired = current;
+        current = *target;
+        target.reset();
+        cursor.reset();
+        Notify(MigrationEvent::Finished, *retired);
+    }
+
+    void Drain() {
+        bool empty = false;
+        With(*retired, [&](auto &storage) {
+            for (size_t i = 0; i < Budget && storage.Size() > 0; ++i) storage.Pop();
+            empty = storage.Size() == 0;
+        });
+        if (!empty) return;
+        if (*retired == AdaptiveLayout::Scan) scan = ScanStorage{allocator};
+        retired.reset();
+    }
+
+    void Sample() {
+        const double n = std::max<double>(1, valid.size());
+        const double lg = std::log2(n + 1);
+        const double heap_cost = (stats.inserts + 2.0 * stats.updates + stats.pops) * lg;
+        const double scan_cost = stats.inserts + stats.updates + stats.pops * n;
+        const bool stale = stats.updates > MaxStaleRatio * (stats.pops + 1) ||
+                           (current == AdaptiveLayout::Heap && heap.Size() > MaxStaleRatio * n);
+
+        AdaptiveLayout best = scan_cost < heap_cost ? AdaptiveLayout::Scan :
+                              stale ? AdaptiveLayout::Set : AdaptiveLayout::Heap;
+        if (best != current && best == candidate && !retired) Start(best);
+        candidate = best;
+        stats = Stats{};
+        sampled = 0;
+    }
+
+    void Notify(typename MigrationEvent::Phase phase, AdaptiveLayout from) {
+        if (listener) listener(MigrationEvent{phase, from, current, valid.size()});
+    }
+
+    void Notify(typename MigrationEvent::Phase phase) {
+        if (listener) listener(MigrationEvent{phase, current, *target, valid.size()});
+    }
+
+    using HeapStorage = typename HeapLayout::template Storage<Pair, PairAllocator>;
+    using SetStorage = typename SetLayout::template Storage<Pair, PairAllocator>;
+    using ScanStorage = typename ScanLayout::template Storage<Pair, PairAllocator>;
+
+    PairAllocator allocator;
+    HeapStorage heap;
+    SetStorage set;
+    ScanStorage scan;
+
+    AdaptiveLayout current = AdaptiveLayout::Heap;
+    std::optional<AdaptiveLayout> target;
+    std::optional<AdaptiveLayout> retired;
+    std::optional<AdaptiveLayout> pending;
+    std::optional<K> cursor;
+
+    Stats stats;
+    size_t sampled = 0;
+    AdaptiveLayout candidate = AdaptiveLayout::Heap;
+    std::function<void(const MigrationEvent &)> listener;
+};
+
+#endif //HARA_ADAPTIVE_SORTED_H
@@ -0,0 +1,496 @@
+#ifndef HARA_BTREE_H
+#define HARA_BTREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+/**
+ * B+-tree holding a sorted set of unique T.
+ * Nodes are cache-line aligned and hold several elements each, so a lookup touches
+ * O(log_B(N)) nodes instead of the O(lg(N)) scattered nodes of a red-black tree.
+ * Elements live in the leaves, which are linked for ordered iteration.
+ * Inner nodes count the elements under each child, so that ranks and selections take O(log_B(N)) too.
+ * T must be default-constructible and move-assignable.
+ * @tparam T
+ * @tparam Less strict weak ordering; front() is the smallest element
+ * @tparam NodeBytes approximate size of one node
+ * @tparam Allocator rebound to allocate whole nodes, which must honour their alignment
+ */
+template<typename T, typename Less = std::less<T>, size_t NodeBytes = 512, typename Allocator = std::allocator<T>>
+class BTree {
+    static constexpr size_t CacheLine = 64;
+    static constexpr size_t Header = 2 * sizeof(size_t) + sizeof(void *);
+
+public:
+    static constexpr size_t LeafCapacity =
+            (NodeBytes - Header) / sizeof(T) > 4 ? (NodeBytes - Header) / sizeof(T) : 4;
+    static constexpr size_t InnerCapacity =
+            (NodeBytes - Header) / (sizeof(T) + sizeof(void *) + sizeof(size_t)) > 4 ?
+            (NodeBytes - Header) / (sizeof(T) + sizeof(void *) + sizeof(size_t)) : 4;
+
+private:
+    struct alignas(CacheLine) Node {
+        explicit Node(bool leaf) : leaf{leaf} {}
+
+        const bool leaf;
+        size_t count = 0;
+    };
+
+    /**
+     * One extra slot so that a node may overflow before it is split
+     */
+    struct Leaf : Node {
+        Leaf() : Node{true} {}
+
+        T items[LeafCapacity + 1];
+        Leaf *next = nullptr;
+    };
+
+    /**
+     * children[i] holds the sizes[i] elements x with keys[i - 1] <= x < keys[i]
+     */
+    struct Inner : Node {
+        Inner() : Node{false} {}
+
+        T keys[InnerCapacity];
+        Node *children[InnerCapacity + 1];
+        size_t sizes[InnerCapacity + 1];
+    };
+
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T *;
+        using reference = const T &;
+
+        const_iterator() = default;
+
+        reference operator*() const { return leaf->items[idx]; }
+
+        pointer operator->() const { return &leaf->items[idx]; }
+
+        const_iterator &operator++() {
+            if (++idx == leaf->count) {
+                leaf = leaf->next;
+                idx = 0;
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            auto copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const const_iterator &that) const { return leaf == that.leaf && idx == that.idx; }
+
+        bool operator!=(const const_iterator &that) const { return !(*this == that); }
+
+    private:
+        friend class BTree;
+
+        const_iterator(const Leaf *leaf, size_t idx) : leaf{leaf}, idx{idx} {}
+
+        const Leaf *leaf = nullptr;
+        size_t idx = 0;
+    };
+
+    explicit BTree(const Allocator &allocator = Allocator())
+            : leaf_allocator{allocator}, inner_allocator{allocator}, root{NewLeaf()}, head{static_cast<Leaf *>(root)} {}
+
+    BTree(const BTree &) = delete;
+
+    BTree &operator=(const BTree &) = delete;
+
+    ~BTree() { Free(root); }
+
+    /**
+     * Complexity: O(1)
+     */
+    const T &front() const { return head->items[0]; }
+
+    bool empty() const { return num == 0; }
+
+    size_t size() const { return num; }
+
+    const_iterator begin() const { return num == 0 ? end() : const_iterator{head, 0}; }
+
+    const_iterator end() const { return const_iterator{}; }
+
+    /**
+     * Complexity: O(log_B(N))
+     * @return false if an equivalent element is already present
+     */
+    bool insert(T value) {
+        Node *sibling = nullptr;
+        T separator;
+        if (!Insert(root, std::move(value), sibling, separator)) return false;
+        if (sibling) {
+            auto *inner = NewInner();
+            inner->children[0] = root;
+            inner->children[1] = sibling;
+            inner->sizes[1] = Size(sibling);
+            inner->sizes[0] = num + 1 - inner->sizes[1];
+            inner->keys[0] = std::move(separator);
+            inner->count = 2;
+            root = inner;
+        }
+        ++num;
+        return true;
+    }
+
+    /**
+     * Complexity: O(log_B(N))
+     * @return false if no equivalent element is present
+     */
+    bool erase(const T &value) {
+        if (!Erase(root, value)) return false;
+        if (!root->leaf && root->count == 1) {
+            auto *inner = static_cast<Inner *>(root);
+            root = inner->children[0];
+            Delete(inner);
+        }
+        --num;
+        return true;
+    }
+
+    /**
+     * Number of leading elements for which before holds; it must hold for a prefix of the elements,
+     * as for std::partition_point
+     * Complexity: O(log_B(N))
+     */
+    template<typename Predicate>
+    size_t rank_if(Predicate before) const {
+        size_t rank = 0;
+        const Node *node = root;
+        while (!node->leaf) {
+            auto *inner = static_cast<const Inner *>(node);
+            const size_t i = std::partition_point(inner->keys, inner->keys + inner->count - 1, before) - inner->keys;
+            for (size_t j = 0; j < i; ++j) rank += inner->sizes[j];
+            node = inner->children[i];
+        }
+        auto *leaf = static_cast<const Leaf *>(node);
+        return rank + (std::partition_point(leaf->items, leaf->items + leaf->count, before) - leaf->items);
+    }
+
+    /**
+     * Number of elements less than value
+     * Complexity: O(log_B(N))
+     */
+    size_t rank(const T &value) const { return rank_if([&value](const T &x) { return less(x, value); }); }
+
+    /**
+     * The element with i elements before it; i must be less than size()
+     * Complexity: O(log_B(N))
+     */
+    const T &select(size_t i) const {
+        const Node *node = root;
+        while (!node->leaf) {
+            auto *inner = static_cast<const Inner *>(node);
+            size_t j = 0;
+            for (; i >= inner->sizes[j]; ++j) i -= inner->sizes[j];
+            node = inner->children[j];
+        }
+        return static_cast<const Leaf *>(node)->items[i];
+    }
+
+    /**
+     * Replaces the contents with the sorted unique elements of [begin, end),
+     * building the tree bottom up with every node at least half full
+     * Complexity: O(N)
+     */
+    template<typename Iterator>
+    void build(Iterator begin, Iterator end) {
+        Free(root);
+        const size_t n = std::distance(begin, end);
+
+        std::vector<Node *> level;
+        std::vector<T> mins;
+        const size_t leaves = std::max<size_t>(1, (n + LeafCapacity - 1) / LeafCapacity);
+        Leaf *prev = nullptr;
+        auto it = begin;
+        for (size_t i = 0; i < leaves; ++i) {
+            auto *leaf = NewLeaf();
+            leaf->count = n / leaves + (i < n % leaves);
+            for (size_t j = 0; j < leaf->count; ++j, ++it) leaf->items[j] = *it;
+            if (prev) prev->next = leaf;
+            else head = leaf;
+            prev = leaf;
+            level.push_back(leaf);
+            if (leaf->count > 0) mins.push_back(leaf->items[0]);
+        }
+
+        // spreading the nodes evenly keeps every one of them at least half full
+        while (level.size() > 1) {
+            const size_t groups = (level.size() + InnerCapacity - 1) / InnerCapacity;
+            std::vector<Node *> parents;
+            std::vector<T> parent_mins;
+            size_t first = 0;
+            for (size_t i = 0; i < groups; ++i) {
+                auto *inner = NewInner();
+                inner->count = level.size() / groups + (i < level.size() % groups);
+                for (size_t j = 0; j < inner->count; ++j) {
+                    inner->children[j] = level[first + j];
+                    inner->sizes[j] = Size(level[first + j]);
+                    if (j > 0) inner->keys[j - 1] = std::move(mins[first + j]);
+                }
+                parents.push_back(inner);
+                parent_mins.push_back(std::move(mins[first]));
+                first += inner->count;
+            }
+            level.swap(parents);
+            mins.swap(parent_mins);
+        }
+        root = level[0];
+        num = n;
+    }
+
+    void clear() {
+        Free(root);
+        root = head = NewLeaf();
+        num = 0;
+    }
+
+private:
+    static constexpr size_t LeafMin = LeafCapacity / 2;
+    static constexpr size_t InnerMin = (InnerCapacity + 1) / 2;
+
+    static bool less(const T &a, const T &b) { return Less()(a, b); }
+
+    static size_t Min(const Node *node) { return node->leaf ? LeafMin : InnerMin; }
+
+    /**
+     * Number of elements under node
+     * Complexity: O(B)
+     */
+    static size_t Size(const Node *node) {
+        if (node->leaf) return node->count;
+        auto *inner = static_cast<const Inner *>(node);
+        return std::accumulate(inner->sizes, inner->sizes + inner->count, size_t{0});
+    }
+
+    static size_t ChildIndex(const Inner *inner, const T &value) {
+        return std::upper_bound(inner->keys, inner->keys + inner->count - 1, value, Less()) - inner->keys;
+    }
+
+    using LeafAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Leaf>;
+    using InnerAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Inner>;
+
+    Leaf *NewLeaf() {
+        return new(std::allocator_traits<LeafAllocator>::allocate(leaf_allocator, 1)) Leaf;
+    }
+
+    Inner *NewInner() {
+        return new(std::allocator_traits<InnerAllocator>::allocate(inner_allocator, 1)) Inner;
+    }
+
+    void Delete(Leaf *leaf) {
+        leaf->~Leaf();
+        std::allocator_traits<LeafAllocator>::deallocate(leaf_allocator, leaf, 1);
+    }
+
+    void Delete(Inner *inner) {
+        inner->~Inner();
+        std::allocator_traits<InnerAllocator>::deallocate(inner_allocator, inner, 1);
+    }
+
+    void Free(Node *node) {
+        if (node->leaf) {
+            Delete(static_cast<Leaf *>(node));
+            return;
+        }
+        auto *inner = static_cast<Inner *>(node);
+        for (size_t i = 0; i < inner->count; ++i) Free(inner->children[i]);
+        Delete(inner);
+    }
+
+    /**
+     * On overflow, node is split and its new right sibling returned through sibling,
+     * along with the smallest element reachable from the sibling
+     */
+    bool Insert(Node *node, T &&value, Node *&sibling, T &separator) {
+        if (node->leaf) {
+            auto *leaf = static_cast<Leaf *>(node);
+            auto pos = std::lower_bound(leaf->items, leaf->items + leaf->count, value, Less());
+            if (pos != leaf->items + leaf->count && !less(value, *pos)) return false;
+            std::move_backward(pos, leaf->items + leaf->count, leaf->items + leaf->count + 1);
+            *pos = std::move(value);
+            if (++leaf->count > LeafCapacity) {
+                auto *right = NewLeaf();
+                const size_t half = leaf->count / 2;
+                std::move(leaf->items + half, leaf->items + leaf->count, right->items);
+                right->count = leaf->count - half;
+                leaf->count = half;
+                right->next = leaf->next;
+                leaf->next = right;
+                separator = right->items[0];
+                sibling = right;
+            }
+            return true;
+        }
+
+        auto *inner = static_cast<Inner *>(node);
+        const size_t i = ChildIndex(inner, value);
+        Node *child_sibling = nullptr;
+        T child_separator;
+        if (!Insert(inner->children[i], std::move(value), child_sibling, child_separator)) return false;
+        ++inner->sizes[i];
+        if (!child_sibling) return true;
+
+        std::move_backward(inner->keys + i, inner->keys + inner->count - 1, inner->keys + inner->count);
+        std::move_backward(inner->children + i + 1, inner->children + inner->count,
+                           inner->children + inner->count + 1);
+        std::copy_backward(inner->sizes + i + 1, inner->sizes + inner->count, inner->sizes + inner->count + 1);
+        inner->keys[i] = std::move(child_separator);
+        inner->children[i + 1] = child_sibling;
+        inner->sizes[i + 1] = Size(child_sibling);
+        inner->sizes[i] -= inner->sizes[i + 1];
+        if (++inner->count > InnerCapacity) {
+            auto *right = NewInner();
+            const size_t half = inner->count / 2;
+            separator = std::move(inner->keys[half - 1]);
+            std::move(inner->keys + half, inner->keys + inner->count - 1, right->keys);
+            std::copy(inner->children + half, inner->children + inner->count, right->children);
+            std::copy(inner->sizes + half, inner->sizes + inner->count, right->sizes);
+            right->count = inner->count - half;
+            inner->count = half;
+            sibling = right;
+        }
+        return true;
+    }
+
+    bool Erase(Node *node, const T &value) {
+        if (node->leaf) {
+            auto *leaf = static_cast<Leaf *>(node);
+            auto pos = std::lower_bound(leaf->items, leaf->items + leaf->count, value, Less());
+            if (pos == leaf->items + leaf->count || less(value, *pos)) return false;
+            std::move(pos + 1, leaf->items + leaf->count, pos);
+            --leaf->count;
+            return true;
+        }
+
+        auto *inner = static_cast<Inner *>(node);
+        const size_t i = ChildIndex(inner, value);
+        if (!Erase(inner->children[i], value)) return false;
+        --inner->sizes[i];
+        if (inner->children[i]->count < Min(inner->children[i])) Rebalance(inner, i);
+        return true;
+    }
+
+    /**
+     * Restores the occupancy of parent->children[i] by borrowing from or merging with a sibling
+     */
+    void Rebalance(Inner *parent, size_t i) {
+        Node *child = parent->children[i];
+        if (i > 0 && parent->children[i - 1]->count > Min(child)) {
+            BorrowFromLeft(parent, i);
+        } else if (i + 1 < parent->count && parent->children[i + 1]->count > Min(child)) {
+            BorrowFromRight(parent, i);
+        } else if (i > 0) {
+            Merge(parent, i - 1);
+        } else {
+            Merge(parent, i);
+        }
+    }
+
+    void BorrowFromLeft(Inner *parent, size_t i) {
+        if (parent->children[i]->leaf) {
+            auto *left = static_cast<Leaf *>(parent->children[i - 1]);
+            auto *child = static_cast<Leaf *>(parent->children[i]);
+            std::move_backward(child->items, child->items + child->count, child->items + child->count + 1);
+            child->items[0] = std::move(left->items[--left->count]);
+            ++child->count;
+            parent->keys[i - 1] = child->items[0];
+            --parent->sizes[i - 1];
+            ++parent->sizes[i];
+            return;
+        }
+        auto *left = static_cast<Inner *>(parent->children[i - 1]);
+        auto *child = static_cast<Inner *>(parent->children[i]);
+        std::move_backward(child->keys, child->keys + child->count - 1, child->keys + child->count);
+        std::move_backward(child->children, child->children + child->count, child->children + child->count + 1);
+        std::copy_backward(child->sizes, child->sizes + child->count, child->sizes + child->count + 1);
+        child->keys[0] = std::move(parent->keys[i - 1]);
+        child->children[0] = left->children[left->count - 1];
+        child->sizes[0] = left->sizes[left->count - 1];
+        parent->sizes[i - 1] -= child->sizes[0];
+        parent->sizes[i] += child->sizes[0];
+        ++child->count;
+        parent->keys[i - 1] = std::move(left->keys[left->count - 2]);
+        --left->count;
+    }
+
+    void BorrowFromRight(Inner *parent, size_t i) {
+        if (parent->children[i]->leaf) {
+            auto *child = static_cast<Leaf *>(parent->children[i]);
+            auto *right = static_cast<Leaf *>(parent->children[i + 1]);
+            child->items[child->count++] = std::move(right->items[0]);
+            std::move(right->items + 1, right->items + right->count, right->items);
+            --right->count;
+            parent->keys[i] = right->items[0];
+            ++parent->sizes[i];
+            --parent->sizes[i + 1];
+            return;
+        }
+        auto *child = static_cast<Inner *>(parent->children[i]);
+        auto *right = static_cast<Inner *>(parent->children[i + 1]);
+        child->keys[child->count - 1] = std::move(parent->keys[i]);
+        child->children[child->count] = right->children[0];
+        child->sizes[child->count] = right->sizes[0];
+        parent->sizes[i] += right->sizes[0];
+        parent->sizes[i + 1] -= right->sizes[0];
+        ++child->count;
+        parent->keys[i] = std::move(right->keys[0]);
+        std::move(right->keys + 1, right->keys + right->count - 1, right->keys);
+        std::move(right->children + 1, right->children + right->count, right->children);
+        std::copy(right->sizes + 1, right->sizes + right->count, right->sizes);
+        --right->count;
+    }
+
+    /**
+     * parent->children[i] absorbs parent->children[i + 1]
+     */
+    void Merge(Inner *parent, size_t i) {
+        if (parent->children[i]->leaf) {
+            auto *left = static_cast<Leaf *>(parent->children[i]);
+            auto *right = static_cast<Leaf *>(parent->children[i + 1]);
+            std::move(right->items, right->items + right->count, left->items + left->count);
+            left->count += right->count;
+            left->next = right->next;
+            Delete(right);
+        } else {
+            auto *left = static_cast<Inner *>(parent->children[i]);
+            auto *right = static_cast<Inner *>(parent->children[i + 1]);
+            left->keys[left->count - 1] = std::move(parent->keys[i]);
+            std::move(right->keys, right->keys + right->count - 1, left->keys + left->count);
+            std::copy(right->children, right->children + right->count, left->children + left->count);
+            std::copy(right->sizes, right->sizes + right->count, left->sizes + left->count);
+            left->count += right->count;
+            Delete(right);
+        }
+        parent->sizes[i] += parent->sizes[i + 1];
+        std::move(parent->keys + i + 1, parent->keys + parent->count - 1, parent->keys + i);
+        std::move(parent->children + i + 2, parent->children + parent->count, parent->children + i + 1);
+        std::copy(parent->sizes + i + 2, parent->sizes + parent->count, parent->sizes + i + 1);
+        --parent->count;
+    }
+
+    LeafAllocator leaf_allocator;
+    InnerAllocator inner_allocator;
+    Node *root;
+    Leaf *head;
+    size_t num = 0;
+};
+
+#endif //HARA_BTREE_H
@@ -0,0 +1,111 @@
+#ifndef HARA_BULK_LOAD_H
+#define HARA_BULK_LOAD_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Which pair survives when a range holds the same key more than once
+ */
+enum class DuplicatePolicy {
+    LastWins,   // the last one in the range, as if inserted one by one with InsertOrUpdate
+    BestWins,   // the one with the greatest value, the last of them on ties
+};
+
+namespace bulk_load {
+
+/**
+ * Below this many elements per thread, sorting is left to a single thread
+ */
+constexpr size_t MinChunk = 1 << 14;
+
+inline size_t Threads() { return std::max(1u, std::thread::hardware_concurrency()); }
+
+template<typename RandomIt, typename Less>
+void Sort(RandomIt begin, RandomIt end, Less less, bool stable, size_t max_threads) {
+    const size_t n = end - begin;
+    const size_t threads = std::min(max_threads, n / MinChunk);
+    if (threads <= 1) {
+        if (stable) std::stable_sort(begin, end, less);
+        else std::sort(begin, end, less);
+        return;
+    }
+
+    std::vector<size_t> bounds(threads + 1);
+    for (size_t i = 0; i <= threads; ++i) bounds[i] = n * i / threads;
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([=] {
+            if (stable) std::stable_sort(begin + bounds[i], begin + bounds[i + 1], less);
+            else std::sort(begin + bounds[i], begin + bounds[i + 1], less);
+        });
+    }
+    for (auto &worker : workers) worker.join();
+
+    // merge neighbouring chunks pairwise, doubling their width each round;
+    // inplace_merge is stable, and the left chunk always precedes the right one
+    for (size_t width = 1; width < threads; width *= 2) {
+        workers.clear();
+        for (size_t i = 0; i + width < threads; i += 2 * width) {
+            const size_t last = std::min(i + 2 * width, threads);
+            workers.emplace_back([=] {
+                std::inplace_merge(begin + bounds[i], begin + bounds[i + width], begin + bounds[last], less);
+            });
+        }
+        for (auto &worker : workers) worker.join();
+    }
+}
+
+}
+
+/**
+ * Sorts on all cores, or on up to threads of them
+ * Complexity: O(N lg(N) / P + N lg(P))
+ */
+template<typename RandomIt, typename Less>
+void ParallelSort(RandomIt begin, RandomIt end, Less less, size_t threads = bulk_load::Threads()) {
+    bulk_load::Sort(begin, end, less, false, threads);
+}
+
+/**
+ * Same as ParallelSort, but keeps equivalent elements in their original order
+ */
+template<typename RandomIt, typename Less>
+void ParallelStableSort(RandomIt begin, RandomIt end, Less less, size_t threads = bulk_load::Threads()) {
+    bulk_load::Sort(begin, end, less, true, threads);
+}
+
+/**
+ * Collects the pairs of a range, sorted by key with one pair per key
+ * Complexity: O(N lg(N) / P + N)
+ * @param less orders the values, for DuplicatePolicy::BestWins
+ */
+template<typename K, typename V, typename Iterator, typename Less>
+std::vector<std::pair<K, V>> Deduplicate(Iterator begin, Iterator end, DuplicatePolicy policy, Less less) {
+    std::vector<std::pair<K, V>> pairs{begin, end};
+    ParallelStableSort(pairs.begin(), pairs.end(), [](const std::pair<K, V> &a, const std::pair<K, V> &b) {
+        return a.first < b.first;
+    });
+
+    // pairs of the same key are adjacent, in their original order
+    size_t out = 0;
+    for (size_t i = 0; i < pairs.size();) {
+        size_t best = i;
+        size_t j = i + 1;
+        for (; j < pairs.size() && !(pairs[i].first < pairs[j].first); ++j)
+            if (policy == DuplicatePolicy::LastWins || !less(pairs[j].second, pairs[best].second))
+                best = j;
+        if (out != best) pairs[out] = std::move(pairs[best]);
+        ++out;
+        i = j;
+    }
+    pairs.erase(pairs.begin() + out, pairs.end());
+    return pairs;
+}
+
+#endif //HARA_BULK_LOAD_H
@@ -0,0 +1,221 @@
+#ifndef HARA_CONCURRENT_PRIORITY_QUEUE_H
+#define HARA_CONCURRENT_PRIORITY_QUEUE_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#endif
+#include "priority_queue.h"
+
+/**
+ * Thread-safe facade over a PriorityQueueImpl backend for producer-consumer pipelines.
+ * Consumers block in PopWait or suspend in co_pop instead of spinning on an empty queue.
+ * Producers only notify as many consumers as there are new elements and sleeping consumers,
+ * and a batch insert wakes them all in a single round.
+ * @tparam Impl
+ */
+template<typename Impl>
+class ConcurrentPriorityQueue {
+public:
+    using K = typename Impl::Key;
+    using V = typename Impl::Value;
+
+    ConcurrentPriorityQueue() = default;
+
+    template<typename Iterator>
+    ConcurrentPriorityQueue(Iterator begin, Iterator end) : queue{begin, end} {}
+
+    ConcurrentPriorityQueue(const ConcurrentPriorityQueue &) = delete;
+
+    ConcurrentPriorityQueue &operator=(const ConcurrentPriorityQueue &) = delete;
+
+    void InsertOrUpdate(std::pair<K, V> pair) {
+        std::unique_lock<std::mutex> lock{mutex};
+        queue.InsertOrUpdate(std::move(pair));
+        Notify(lock, 1);
+    }
+
+    /**
+     * Inserts the whole range under one lock and wakes consumers once
+     */
+    template<typename Iterator>
+    void InsertOrUpdate(Iterator begin, Iterator end) {
+        std::unique_lock<std::mutex> lock{mutex};
+        size_t count = 0;
+        for (auto it = begin; it != end; ++it, ++count)
+            queue.InsertOrUpdate(*it);
+        Notify(lock, count);
+    }
+
+    void Erase(const K &key) {
+        std::lock_guard<std::mutex> lock{mutex};
+        queue.Erase(key);
+    }
+
+    bool Contain(const K &key) const {
+        std::lock_guard<std::mutex> lock{mutex};
+        return queue.Contain(key);
+    }
+
+    bool Empty() const {
+        std::lock_guard<std::mutex> lock{mutex};
+        return queue.Empty();
+    }
+
+    size_t Size() const {
+        std::lock_guard<std::mutex> lock{mutex};
+        return queue.Size();
+    }
+
+    /**
+     * @return a copy of the top element, or nothing if empty
+     */
+    std::optional<std::pair<K, V>> TryTop() const {
+        std::lock_guard<std::mutex> lock{mutex};
+        auto top = queue.TryTop();
+        if (!top) return std::nullopt;
+        return *top;
+    }
+
+    /**
+     * Takes no lock: with a backend such as SnapshotSorted, readers never wait for the writers
+     * @return an immutable view that can be read from any thread
+     */
+    auto TakeSnapshot() const { return queue.TakeSnapshot(); }
+
+    auto TryTakeSnapshot() const { return queue.TryTakeSnapshot(); }
+
+    /**
+     * Never blocks on an empty queue
+     * @return the popped top element, or nothing if empty
+     */
+    std::optional<std::pair<K, V>> TryPop() {
+        std::lock_guard<std::mutex> lock{mutex};
+        return PopLocked();
+    }
+
+    /**
+     * Blocks until an element is available or timeout elapses
+     * @return the popped top element, or nothing on timeout
+     */
+    template<typename Rep, typename Period>
+    std::optional<std::pair<K, V>> PopWait(const std::chrono::duration<Rep, Period> &timeout) {
+        const auto deadline = Deadline(timeout);
+        std::unique_lock<std::mutex> lock{mutex};
+        ++waiting;
+        while (queue.Empty()) {
+            const auto status = cv.wait_until(lock, deadline);
+            // any wakeup counts against the signals, so that they are never overcounted
+            if (signaled > 0) --signaled;
+            if (status == std::cv_status::timeout) break;
+        }
+        --waiting;
+        return PopLocked();
+    }
+
+#if defined(__cpp_impl_coroutine)
+
+    class PopAwaiter {
+    public:
+        explicit PopAwaiter(ConcurrentPriorityQueue &queue) : queue{queue} {}
+
+        bool await_ready() const { return false; }
+
+        /**
+         * Does not suspend if an element is available already
+         */
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::lock_guard<std::mutex> lock{queue.mutex};
+            result = queue.PopLocked();
+            if (result) return false;
+            this->handle = handle;
+            queue.awaiters.push_back(this);
+            return true;
+        }
+
+        std::pair<K, V> await_resume() { return std::move(*result); }
+
+    private:
+        friend class ConcurrentPriorityQueue;
+
+        ConcurrentPriorityQueue &queue;
+        std::optional<std::pair<K, V>> result;
+        std::coroutine_handle<> handle;
+    };
+
+    /**
+     * co_await co_pop() suspends the coroutine until an element is available.
+     * Suspended coroutines are served in FIFO order, before threads blocked in PopWait,
+     * and are resumed on the producer's thread once it has released the lock.
+     * They must all be resumed before the queue is destroyed.
+     */
+    PopAwaiter co_pop() { return PopAwaiter{*this}; }
+
+#endif
+
+private:
+    std::optional<std::pair<K, V>> PopLocked() {
+        auto pair = queue.TryTop();
+        if (!pair) return std::nullopt;
+        std::optional<std::pair<K, V>> top{*pair};
+        queue.Pop();
+        return top;
+    }
+
+    /**
+     * now + timeout, capped at the greatest time point so that long timeouts such as hours::max() do not overflow
+     */
+    template<typename Rep, typename Period>
+    static std::chrono::steady_clock::time_point Deadline(const std::chrono::duration<Rep, Period> &timeout) {
+        using Clock = std::chrono::steady_clock;
+        const auto now = Clock::now();
+        // compared in floating point, as converting timeout to the clock's ticks may overflow too
+        if (std::chrono::duration<double>(timeout) >= std::chrono::duration<double>(Clock::time_point::max() - now))
+            return Clock::time_point::max();
+        return now + std::chrono::duration_cast<Clock::duration>(timeout);
+    }
+
+    /**
+     * Hands new elements to suspended coroutines first, then wakes up to count blocked threads
+     * that have not been signaled yet. Unlocks the lock.
+     */
+    void Notify(std::unique_lock<std::mutex> &lock, size_t count) {
+#if defined(__cpp_impl_coroutine)
+        std::vector<std::coroutine_handle<>> ready;
+        while (!awaiters.empty() && count > 0 && !queue.Empty()) {
+            auto *awaiter = awaiters.front();
+            awaiters.pop_front();
+            awaiter->result = PopLocked();
+            ready.push_back(awaiter->handle);
+            --count;
+        }
+#endif
+        const size_t wake = std::min(std::min(count, queue.Size()), waiting - signaled);
+        signaled += wake;
+        const bool all = wake == waiting;
+        lock.unlock();
+
+        if (all && wake > 0) cv.notify_all();
+        else for (size_t i = 0; i < wake; ++i) cv.notify_one();
+#if defined(__cpp_impl_coroutine)
+        for (auto handle : ready) handle.resume();
+#endif
+    }
+
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    PriorityQueue<Impl> queue;
+    size_t waiting = 0;
+    size_t signaled = 0;
+#if defined(__cpp_impl_coroutine)
+    std::deque<PopAwaiter *> awaiters;
+#endif
+};
+
+#endif //HARA_CONCURRENT_PRIORITY_QUEUE_H
@@ -0,0 +1,189 @@
+#ifndef HARA_DECAYING_PRIORITY_QUEUE_H
+#define HARA_DECAYING_PRIORITY_QUEUE_H
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <vector>
+#include "priority_queue.h"
+#include "priority_queue_impl.h"
+
+/**
+ * Priority queue whose scores decay exponentially with time and whose entries may expire.
+ *
+ * A score s inserted at time t0 is worth s * exp(-rate * (t - t0)) at time t.
+ * Decay preserves the relative order of the entries, so each one is stored once
+ * as log(s) + rate * t0 and is never touched again as time passes.
+ * Expired entries are dropped lazily by Top and Pop, or incrementally by Sweep.
+ * @tparam Backend one of the PriorityQueueImpl backends, e.g. PriorityQueueSorted
+ * @tparam K
+ * @tparam Clock
+ */
+template<template<typename, typename, typename> class Backend, typename K,
+        typename Clock = std::chrono::steady_clock>
+class DecayingPriorityQueue {
+public:
+    using Duration = typename Clock::duration;
+    using TimePoint = typename Clock::time_point;
+
+    /**
+     * @param rate decay per second; 0 keeps the scores constant
+     */
+    explicit DecayingPriorityQueue(double rate = 0) : rate{rate}, epoch{Clock::now()} {}
+
+    /**
+     * Complexity: Amortized O(1) plus O(lg(N)) per expired entry dropped
+     * @return the top key along with its score as of now
+     */
+    std::pair<K, double> Top() {
+        const auto now = Clock::now();
+        DropExpired(now);
+        Assert (!queue.Empty());
+        const auto &top = queue.Top();
+        return {top.first, Score(top.second, now)};
+    }
+
+    /**
+     * Complexity: same as the backend, plus O(lg(N)) per expired entry dropped
+     */
+    void Pop() {
+        DropExpired(Clock::now());
+        queue.Pop();
+        DropExpired(Clock::now());
+        Compact();
+    }
+
+    /**
+     * Drops the expired entries at the top, hence not const
+     */
+    bool Empty() {
+        DropExpired(Clock::now());
+        return queue.Empty();
+    }
+
+    /**
+     * May count expired entries that have not been dropped yet
+     */
+    size_t Size() const { return queue.Size(); }
+
+    /**
+     * Complexity: amortized O(lg(N))
+     * @param score must be positive
+     * @param ttl the entry expires after ttl; zero never expires
+     */
+    void InsertOrUpdate(const K &key, double score, Duration ttl = Duration::zero()) {
+        Assert (score > 0);
+        const auto now = Clock::now();
+        const auto deadline = ttl > Duration::zero() ? now + ttl : TimePoint::max();
+        queue.InsertOrUpdate({key, Entry{std::log(score) + rate * Elapsed(now), deadline}});
+        if (ttl > Duration::zero()) expiry.emplace(deadline, key);
+        Compact();
+    }
+
+    /**
+     * Complexity: amortized O(lg(N))
+     */
+    void Erase(const K &key) {
+        queue.Erase(key);
+        Compact();
+    }
+
+    /**
+     * Complexity: O(lg(N))
+     */
+    bool Contain(const K &key) const {
+        auto entry = queue.TryPeek(key);
+        return entry && entry->deadline > Clock::now();
+    }
+
+    /**
+     * fails Assert if key not found or expired
+     * @return the score of key as of now
+     */
+    double Peek(const K &key) const {
+        const auto now = Clock::now();
+        auto entry = queue.TryPeek(key);
+        Assert (entry && entry->deadline > now);
+        return Score(*entry, now);
+    }
+
+    /**
+     * Drops expired entries anywhere in the queue, in order of expiry,
+     * examining at most budget of them so that no call stalls for long
+     * Complexity: O(budget * lg(N))
+     * @return number of entries dropped
+     */
+    size_t Sweep(size_t budget) {
+        const auto now = Clock::now();
+        size_t dropped = 0;
+        for (; budget > 0 && !expiry.empty() && expiry.top().first <= now; --budget) {
+            const auto &key = expiry.top().second;
+            // the key may have been updated or erased since this deadline was scheduled
+            auto entry = queue.TryPeek(key);
+            if (entry && entry->deadline == expiry.top().first) {
+                queue.Erase(key);
+                ++dropped;
+            }
+            expiry.pop();
+        }
+        return dropped;
+    }
+
+    /**
+     * Number of deadlines scheduled for Sweep, stale ones included; at most about twice Size
+     */
+    size_t Deadlines() const { return expiry.size(); }
+
+private:
+    struct Entry {
+        double anchor;
+        TimePoint deadline;
+    };
+
+    /**
+     * Orders by anchor, breaking ties on deadline so that the backends
+     * can tell an entry apart from its stale copies
+     */
+    struct EntryCompare {
+        bool operator()(const Entry &a, const Entry &b) const {
+            return a.anchor < b.anchor || (a.anchor == b.anchor && a.deadline < b.deadline);
+        }
+    };
+
+    double Elapsed(TimePoint now) const {
+        return std::chrono::duration<double>(now - epoch).count();
+    }
+
+    double Score(const Entry &entry, TimePoint now) const {
+        return std::exp(entry.anchor - rate * Elapsed(now));
+    }
+
+    void DropExpired(TimePoint now) {
+        while (!queue.Empty() && queue.Top().second.deadline <= now)
+            queue.Pop();
+    }
+
+    /**
+     * Rebuilds the deadlines from the live entries once the stale ones outnumber them,
+     * so that refreshing a key long before it expires does not pile up deadlines
+     * Complexity: O(N lg(N)) once every N stale deadlines at least, hence amortized O(lg(N))
+     */
+    void Compact() {
+        if (expiry.size() <= 2 * queue.Size()) return;
+        std::vector<Expiry> live;
+        for (auto &key : queue.Keys()) {
+            const auto deadline = queue.TryPeek(key)->deadline;
+            if (deadline != TimePoint::max()) live.emplace_back(deadline, std::move(key));
+        }
+        expiry = decltype(expiry){std::greater<Expiry>(), std::move(live)};
+    }
+
+    using Expiry = std::pair<TimePoint, K>;
+    const double rate;
+    const TimePoint epoch;
+    PriorityQueue<Backend<K, Entry, EntryCompare>> queue;
+    std::priority_queue<Expiry, std::vector<Expiry>, std::greater<Expiry>> expiry;
+};
+
+#endif //HARA_DECAYING_PRIORITY_QUEUE_H
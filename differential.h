@@ -0,0 +1,273 @@
+#ifndef HARA_DIFFERENTIAL_H
+#define HARA_DIFFERENTIAL_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <type_traits>
+#include <vector>
+#include "adaptive_sorted.h"
+#include "external_sorted.h"
+#include "fixed_priority_queue.h"
+#include "numa_priority_queue.h"
+#include "priority_queue.h"
+#include "priority_queue_impl.h"
+#include "snapshot_sorted.h"
+
+/**
+ * Differential testing of the backends against a reference model.
+ *
+ * An input is any byte string, so that it can come from a fuzzer:
+ * byte 0          number of pairs to bulk load (low 3 bits) and DuplicatePolicy (bit 3)
+ * 2 bytes / pair  key, value
+ * 3 bytes / op    operation, key, value
+ * Values are taken modulo 16 so that ties and stale copies of equal value are common.
+ */
+namespace differential {
+
+enum {
+    INSERT = 0,
+    ERASE = 1,
+    POP = 2,
+    PEEK = 3,
+    NUM_OPS = 4
+};
+
+constexpr int NUM_VALUES = 16;
+
+struct Operation {
+    int op;
+    int key;
+    int value;
+};
+
+struct Input {
+    DuplicatePolicy policy = DuplicatePolicy::LastWins;
+    std::vector<std::pair<int, int>> bulk;
+    std::vector<Operation> ops;
+};
+
+inline Input Decode(const uint8_t *data, size_t size) {
+    Input input;
+    if (size == 0) return input;
+    const size_t num_bulk = data[0] & 7;
+    input.policy = data[0] & 8 ? DuplicatePolicy::BestWins : DuplicatePolicy::LastWins;
+    size_t pos = 1;
+    for (size_t i = 0; i < num_bulk && pos + 2 <= size; ++i, pos += 2)
+        input.bulk.emplace_back(data[pos], data[pos + 1] % NUM_VALUES);
+    for (; pos + 3 <= size; pos += 3)
+        input.ops.push_back({data[pos] % NUM_OPS, data[pos + 1], data[pos + 2] % NUM_VALUES});
+    return input;
+}
+
+/**
+ * The simplest possible priority queue: a map, scanned for its top
+ */
+class Model {
+public:
+    Model(const std::vector<std::pair<int, int>> &bulk, DuplicatePolicy policy) {
+        for (auto &pair : bulk) {
+            auto it = map.emplace(pair).first;
+            if (policy == DuplicatePolicy::LastWins || it->second < pair.second) it->second = pair.second;
+        }
+    }
+
+    std::pair<int, int> Top() const {
+        return *std::max_element(map.begin(), map.end(), [](const std::pair<const int, int> &a,
+                                                              const std::pair<const int, int> &b) {
+            return a.second < b.second || (a.second == b.second && a.first < b.first);
+        });
+    }
+
+    void Pop() { if (!map.empty()) map.erase(Top().first); }
+
+    std::map<int, int> map;
+};
+
+inline void Expect(bool condition, const char *what, const char *backend, size_t step) {
+    if (condition) return;
+    std::cerr << backend << ": " << what << " differs from the model at step " << step << std::endl;
+    std::abort();
+}
+
+template<typename Impl, typename = void>
+struct HasViews : std::false_type {};
+
+template<typename Impl>
+struct HasViews<Impl, std::void_t<decltype(std::declval<const Impl &>().SortedEntriesView())>> : std::true_type {};
+
+template<typename Impl>
+void Check(const PriorityQueue<Impl> &queue, const Model &model, int key, const char *backend, size_t step) {
+    Expect(queue.Empty() == model.map.empty(), "Empty", backend, step);
+    Expect(queue.Size() == model.map.size(), "Size", backend, step);
+    if (!model.map.empty()) {
+        Expect(queue.Top() == model.Top(), "Top", backend, step);
+        Expect(queue.TryTop() && *queue.TryTop() == model.Top(), "TryTop", backend, step);
+    } else {
+        Expect(!queue.TryTop(), "TryTop", backend, step);
+    }
+
+    auto it = model.map.find(key);
+    Expect(queue.Contain(key) == (it != model.map.end()), "Contain", backend, step);
+    if (it != model.map.end()) {
+        Expect(queue.Peek(key) == it->second, "Peek", backend, step);
+        Expect(queue.TryPeek(key) && *queue.TryPeek(key) == it->second, "TryPeek", backend, step);
+    } else {
+        Expect(!queue.TryPeek(key), "TryPeek", backend, step);
+    }
+
+    auto keys = queue.Keys();
+    std::sort(keys.begin(), keys.end());
+    Expect(keys.size() == model.map.size() &&
+           std::equal(keys.begin(), keys.end(), model.map.begin(),
+                      [](int a, const std::pair<const int, int> &b) { return a == b.first; }),
+           "Keys", backend, step);
+
+    if constexpr (HasViews<Impl>::value) {
+        std::vector<int> viewed;
+        for (const auto &key : queue.KeysView()) viewed.push_back(key);
+        std::sort(viewed.begin(), viewed.end());
+        Expect(viewed == keys, "KeysView", backend, step);
+
+        size_t count = 0;
+        for (const auto &entry : queue.EntriesView())
+            count += model.map.count(entry.first) && model.map.at(entry.first) == entry.second;
+        Expect(count == model.map.size(), "EntriesView", backend, step);
+
+        std::vector<std::pair<int, int>> sorted{model.map.begin(), model.map.end()}, walked;
+        std::sort(sorted.begin(), sorted.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+            return a.second > b.second || (a.second == b.second && a.first > b.first);
+        });
+        for (const auto &entry : queue.SortedEntriesView()) walked.emplace_back(entry.first, entry.second);
+        Expect(walked == sorted, "SortedEntriesView", backend, step);
+    }
+}
+
+template<typename Impl>
+void Run(const Input &input, const char *backend) {
+    PriorityQueue<Impl> queue{input.bulk.begin(), input.bulk.end(), input.policy};
+    Model model{input.bulk, input.policy};
+    Check(queue, model, 0, backend, 0);
+
+    for (size_t step = 0; step < input.ops.size(); ++step) {
+        const auto &op = input.ops[step];
+        switch (op.op) {
+            case INSERT:
+                queue.InsertOrUpdate({op.key, op.value});
+                model.map[op.key] = op.value;
+                break;
+            case ERASE:
+                queue.Erase(op.key);
+                model.map.erase(op.key);
+                break;
+            case POP:
+                queue.Pop();
+                model.Pop();
+                break;
+            default:
+                break;
+        }
+        Check(queue, model, op.key, backend, step + 1);
+    }
+}
+
+/**
+ * ExternalSorted with blocks of 4 records, 4 of them in memory and fanout 2, so that short inputs
+ * spill runs, merge them and the tables level by level, and meet tombstones at the top
+ */
+class SmallExternalSorted : public ExternalSorted<int, int> {
+public:
+    SmallExternalSorted() : ExternalSorted{Options()} {}
+
+    template<typename Iterator>
+    SmallExternalSorted(Iterator begin, Iterator end, DuplicatePolicy policy)
+            : ExternalSorted{begin, end, policy, Options()} {}
+
+private:
+    static ExternalOptions Options() {
+        ExternalOptions options;
+        options.block_size = 4 * sizeof(external::Record<int, int>);
+        options.memory_budget = 4 * options.block_size;
+        options.page_size = 4 * sizeof(external::Entry<int, int>);
+        options.fanout = 2;
+        return options;
+    }
+};
+
+/**
+ * FixedPriorityQueue behind the PriorityQueueImpl interface. It has room for every key of a byte,
+ * and its hash sends every key to one of 3 home slots, so that erases and pops go through backward-shift deletion
+ */
+class FixedSorted : public PriorityQueueImpl<int, int> {
+    struct Collide {
+        size_t operator()(int key) const { return key % 3; }
+    };
+
+public:
+    FixedSorted() = default;
+
+    template<typename Iterator>
+    FixedSorted(Iterator begin, Iterator end, DuplicatePolicy policy) {
+        for (auto &pair : Deduplicate<int, int>(begin, end, policy, less)) InsertOrUpdate(pair);
+    }
+
+    const std::pair<int, int> &Top() const override { return queue.Top(); }
+
+    void Pop() override { queue.Pop(); }
+
+    bool Empty() const override { return queue.Empty(); }
+
+    size_t Size() const override { return queue.Size(); }
+
+    void InsertOrUpdate(std::pair<int, int> pair) override {
+        const auto status = queue.InsertOrUpdate(std::move(pair));
+        Assert (status == FixedStatus::Ok);
+    }
+
+    void Erase(const int &key) override { queue.Erase(key); }
+
+    bool Contain(const int &key) const override { return queue.Contain(key); }
+
+    const int &Peek(const int &key) const override { return queue.Peek(key); }
+
+    const std::pair<int, int> *TryTop() const override { return queue.TryTop(); }
+
+    const int *TryPeek(const int &key) const override { return queue.TryPeek(key); }
+
+    std::vector<int> Keys() const override {
+        std::vector<int> keys;
+        for (int key : queue.KeysView()) keys.push_back(key);
+        return keys;
+    }
+
+private:
+    FixedPriorityQueue<int, int, 256, std::less<int>, Collide> queue;
+};
+
+/**
+ * Runs the input against every backend, aborting on the first difference
+ */
+inline void RunAll(const uint8_t *data, size_t size) {
+    const auto input = Decode(data, size);
+    Run<PriorityQueueSorted<int, int>>(input, "PriorityQueueSorted");
+    Run<SetSorted<int, int>>(input, "SetSorted");
+    Run<BTreeSorted<int, int>>(input, "BTreeSorted");
+    Run<MapSorted<int, int>>(input, "MapSorted");
+    Run<SortedEngine<int, int, HeapLayout, std::less<int>, HashedIndex>>(input, "HeapLayout+HashedIndex");
+    Run<SortedEngine<int, int, ScanLayout, std::less<int>, HashedIndex>>(input, "ScanLayout+HashedIndex");
+    // tiny windows and budgets, so that migrations start and overlap with the updates
+    Run<AdaptiveSorted<int, int, std::less<int>, 16, 4>>(input, "AdaptiveSorted");
+    Run<AdaptiveSorted<int, int, std::less<int>, 16, 4, OrderedIndex, NodeAllocator<std::pair<const int, int>>>>(
+            input, "AdaptiveSorted<NodeAllocator>");
+    Run<SnapshotSorted<int, int>>(input, "SnapshotSorted");
+    Run<NumaSorted<int, int, HeapLayout>>(input, "NumaSorted<HeapLayout>");
+    Run<NumaSorted<int, int, BTreeLayout>>(input, "NumaSorted<BTreeLayout>");
+    Run<SmallExternalSorted>(input, "ExternalSorted");
+    Run<FixedSorted>(input, "FixedPriorityQueue");
+}
+
+}
+
+#endif //HARA_DIFFERENTIAL_H
@@ -0,0 +1,783 @@
+#ifndef HARA_EXTERNAL_SORTED_H
+#define HARA_EXTERNAL_SORTED_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "priority_queue_impl.h"
+
+struct ExternalOptions {
+    size_t memory_budget = 64 << 20;    // bytes for the insertion heap and the recent updates of the key index
+    size_t block_size = 1 << 20;        // bytes per sequential read or write
+    size_t page_size = 4 << 10;         // bytes read per key lookup; the key index keeps one key per page in memory
+    size_t fanout = 8;                  // runs of a level merged into one of the next level
+    std::string directory;              // where the runs are written; the temporary directory if empty
+};
+
+namespace external {
+
+/**
+ * A pair in priority order. An erased one is a tombstone: it cancels the copy of the same key and value
+ * written before it, and sorts right before that copy so that the two meet in every merge
+ */
+template<typename K, typename V>
+struct Record {
+    K key;
+    V value;
+    uint64_t seq;
+    bool erased;
+};
+
+/**
+ * A pair in key order. An erased one hides the key from the older tables
+ */
+template<typename K, typename V>
+struct Entry {
+    K key;
+    V value;
+    bool erased;
+};
+
+/**
+ * A sorted run file, read back one block at a time and removed once destroyed
+ */
+template<typename Record>
+class Run {
+public:
+    Run(std::string path, size_t count, size_t block_records, size_t level)
+            : path{std::move(path)}, file{std::fopen(this->path.c_str(), "rb")}, remaining{count},
+              capacity{block_records}, level{level} {
+        Assert (file);
+        Load();
+    }
+
+    Run(const Run &) = delete;
+
+    Run &operator=(const Run &) = delete;
+
+    ~Run() {
+        std::fclose(file);
+        std::remove(path.c_str());
+    }
+
+    bool Empty() const { return pos == block.size(); }
+
+    const Record &Head() const { return block[pos]; }
+
+    void Next() { if (++pos == block.size()) Load(); }
+
+    /**
+     * 0 for a run written from memory, and one more for every merge it went through
+     */
+    size_t Level() const { return level; }
+
+private:
+    void Load() {
+        block.resize(std::min(capacity, remaining));
+        // kept out of Assert, which may compile to nothing
+        const size_t read = std::fread(block.data(), sizeof(Record), block.size(), file);
+        Assert (read == block.size());
+        remaining -= block.size();
+        pos = 0;
+    }
+
+    std::string path;
+    std::FILE *file;
+    size_t remaining;
+    size_t capacity;
+    size_t level;
+    std::vector<Record> block;
+    size_t pos = 0;
+};
+
+/**
+ * Writes a run sequentially, one block at a time
+ */
+template<typename Record>
+class RunWriter {
+public:
+    RunWriter(const std::string &path, size_t block_records) : file{std::fopen(path.c_str(), "wb")},
+                                                               capacity{block_records} {
+        Assert (file);
+        block.reserve(capacity);
+    }
+
+    RunWriter(const RunWriter &) = delete;
+
+    RunWriter &operator=(const RunWriter &) = delete;
+
+    ~RunWriter() { if (file) std::fclose(file); }
+
+    void Append(const Record &record) {
+        block.push_back(record);
+        if (block.size() == capacity) Flush();
+    }
+
+    /**
+     * Number of records appended so far
+     */
+    size_t Count() const { return count + block.size(); }
+
+    /**
+     * @return the number of records written
+     */
+    size_t Finish() {
+        Flush();
+        const int closed = std::fclose(file);
+        Assert (closed == 0);
+        file = nullptr;
+        return count;
+    }
+
+private:
+    void Flush() {
+        const size_t written = std::fwrite(block.data(), sizeof(Record), block.size(), file);
+        Assert (written == block.size());
+        count += block.size();
+        block.clear();
+    }
+
+    std::FILE *file;
+    size_t capacity;
+    std::vector<Record> block;
+    size_t count = 0;
+};
+
+/**
+ * A file of entries sorted by key, removed once destroyed.
+ * The first key of every page is kept in memory, so that a lookup reads a single page
+ */
+template<typename K, typename Entry>
+class Table {
+public:
+    Table(std::string path, size_t count, std::vector<K> fences, K last, size_t page_entries, size_t level)
+            : path{std::move(path)}, file{std::fopen(this->path.c_str(), "rb")}, count{count},
+              fences{std::move(fences)}, last{std::move(last)}, page_entries{page_entries}, level{level} {
+        Assert (file);
+    }
+
+    Table(const Table &) = delete;
+
+    Table &operator=(const Table &) = delete;
+
+    ~Table() {
+        std::fclose(file);
+        std::remove(path.c_str());
+    }
+
+    /**
+     * 0 for a table written from memory, and one more for every merge it went through
+     */
+    size_t Level() const { return level; }
+
+    /**
+     * Complexity: O(lg(N / P)) plus a read of one page of P entries, unless key is out of the table's range
+     * @return the entry of key, read into page, or nullptr if the table has none
+     */
+    const Entry *Find(const K &key, std::vector<Entry> &page) const {
+        if (key < fences.front() || last < key) return nullptr;
+        const size_t i = std::upper_bound(fences.begin(), fences.end(), key) - fences.begin() - 1;
+        Load(i * page_entries, page_entries, page);
+        auto it = std::lower_bound(page.begin(), page.end(), key, [](const Entry &entry, const K &key) {
+            return entry.key < key;
+        });
+        return it != page.end() && !(key < it->key) ? &*it : nullptr;
+    }
+
+    /**
+     * Reads up to limit entries, from position first on; safe for concurrent readers, which share the file
+     */
+    void Load(size_t first, size_t limit, std::vector<Entry> &entries) const {
+        entries.resize(std::min(limit, count - std::min(first, count)));
+        if (entries.empty()) return;
+        std::lock_guard<std::mutex> lock{mutex};
+        // kept out of Assert, which may compile to nothing
+        const int sought = std::fseek(file, static_cast<long>(first * sizeof(Entry)), SEEK_SET);
+        Assert (sought == 0);
+        const size_t read = std::fread(entries.data(), sizeof(Entry), entries.size(), file);
+        Assert (read == entries.size());
+    }
+
+private:
+    std::string path;
+    std::FILE *file;
+    mutable std::mutex mutex;
+    size_t count;
+    std::vector<K> fences;
+    K last;
+    size_t page_entries;
+    size_t level;
+};
+
+/**
+ * Reads a table sequentially, one block at a time
+ */
+template<typename Table, typename Entry>
+class TableReader {
+public:
+    TableReader(const Table &table, size_t block_entries) : table{&table}, capacity{block_entries} { Load(); }
+
+    bool Empty() const { return pos == block.size(); }
+
+    const Entry &Head() const { return block[pos]; }
+
+    void Next() { if (++pos == block.size()) Load(); }
+
+private:
+    void Load() {
+        table->Load(next, capacity, block);
+        next += block.size();
+        pos = 0;
+    }
+
+    const Table *table;
+    size_t capacity;
+    std::vector<Entry> block;
+    size_t next = 0;
+    size_t pos = 0;
+};
+
+}
+
+/**
+ * Disk-backed backend for queues that do not fit in memory, as a buffered sequence heap
+ * along with a key index in the manner of an LSM tree.
+ *
+ * New records go to an in-memory insertion heap; when it is full, it is sorted and written out as a run
+ * with large sequential writes. Runs are read back one block at a time, so the top is the greatest of the
+ * insertion heap's and of the runs' heads, and pops merge the runs lazily. Once fanout runs share a level,
+ * they are merged into one of the next level, so that every record is written O(log_fanout(N / M)) times.
+ *
+ * An update or an erase writes a tombstone carrying the key and its previous value. It sorts right before
+ * the copy it cancels, so the two are dropped together wherever they meet: in a merge, or at the top.
+ * The previous value comes from the key index: the recent updates in memory, and older ones in tables
+ * sorted by key, merged by level the same way, newer entries hiding older ones.
+ * Memory holds the insertion heap, the recent updates, a block per run being read and a key per page of the tables.
+ * Requires K and V to be trivially copyable
+ * @tparam K
+ * @tparam V
+ */
+template<typename K, typename V, typename Compare = std::less<V>>
+class ExternalSorted : public PriorityQueueImpl<K, V, Compare> {
+    static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+                  "ExternalSorted writes K and V to disk as they are");
+
+    using Base = PriorityQueueImpl<K, V, Compare>;
+    using Record = external::Record<K, V>;
+    using Entry = external::Entry<K, V>;
+    using Run = external::Run<Record>;
+    using Table = external::Table<K, Entry>;
+    using TableReader = external::TableReader<Table, Entry>;
+
+    struct Slot {
+        V value;
+        bool erased;
+    };
+
+    using Recent = std::map<K, Slot>;
+
+public:
+    /**
+     * memory_budget is split evenly between the insertion heap and the recent updates of the key index
+     */
+    explicit ExternalSorted(ExternalOptions options = ExternalOptions{})
+            : options{std::move(options)},
+              block_records{std::max<size_t>(1, this->options.block_size / sizeof(Record))},
+              block_entries{std::max<size_t>(1, this->options.block_size / sizeof(Entry))},
+              page_entries{std::max<size_t>(1, this->options.page_size / sizeof(Entry))} {
+        // a tree node holds its colour and three pointers besides the entry
+        const size_t node_size = sizeof(typename Recent::value_type) + 4 * sizeof(void *);
+        buffer_capacity = this->options.memory_budget / 2 / sizeof(Record);
+        recent_capacity = this->options.memory_budget / 2 / node_size;
+        Assert (this->options.fanout >= 2 && buffer_capacity >= 1 && recent_capacity >= 1);
+        if (this->options.directory.empty()) this->options.directory = std::filesystem::temp_directory_path().string();
+        prefix = (std::filesystem::path{this->options.directory} /
+                  ("sorted-" + std::to_string(std::random_device{}()) + "-" + std::to_string(Instances()++) + "-")).string();
+    }
+
+    /**
+     * Bulk load: deduplicates keys according to policy, then writes them out as a single table and a single run
+     * Complexity: O(N lg(N) / P + N / B) I/Os of B records
+     */
+    template<typename Iterator>
+    explicit ExternalSorted(Iterator begin, Iterator end, DuplicatePolicy policy = DuplicatePolicy::LastWins,
+                            ExternalOptions options = ExternalOptions{})
+            : ExternalSorted{std::move(options)} {
+        auto pairs = Deduplicate<K, V>(begin, end, policy, Base::less);
+        size = pairs.size();
+
+        // sorted by key already
+        const auto table_path = NextPath();
+        TableWriter table_writer{table_path, *this};
+        for (const auto &pair : pairs) table_writer.Append(Entry{pair.first, pair.second, false});
+        AddTable(table_path, table_writer, 0, 0);
+
+        std::vector<Record> records;
+        records.reserve(pairs.size());
+        for (const auto &pair : pairs) records.push_back(Record{pair.first, pair.second, next_seq++, false});
+        pairs = {};
+        ParallelSort(records.begin(), records.end(), Greater);
+
+        const auto run_path = NextPath();
+        RunWriter run_writer{run_path, block_records};
+        for (const auto &record : records) run_writer.Append(record);
+        AddRun(run_path, run_writer.Finish(), 0);
+        Settle();
+    }
+
+    ExternalSorted(const ExternalSorted &) = delete;
+
+    ExternalSorted &operator=(const ExternalSorted &) = delete;
+
+    ~ExternalSorted() override = default;
+
+    /**
+     * Complexity: O(1)
+     */
+    const std::pair<K, V> &Top() const override {
+        Assert (top);
+        return *top;
+    }
+
+    /**
+     * Complexity: O(1)
+     * @return nullptr if empty
+     */
+    const std::pair<K, V> *TryTop() const override { return top ? &*top : nullptr; }
+
+    /**
+     * Complexity: amortized O(lg(M) + R) plus one block read every B records, for M records in memory and R runs
+     */
+    void Pop() override {
+        if (!top) return;
+        Remember(top->first, nullptr);
+        --size;
+        Advance(source);
+        Settle();
+    }
+
+    bool Empty() const override { return size == 0; }
+
+    size_t Size() const override { return size; }
+
+    /**
+     * Complexity: a lookup, plus amortized O(lg(M)) and O(log_fanout(N / M) / B) I/Os of B records
+     */
+    void InsertOrUpdate(std::pair<K, V> pair) override {
+        auto previous = Find(pair.first);
+        if (previous) Push(Record{pair.first, *previous, next_seq++, true});
+        else ++size;
+
+        const Record record{pair.first, pair.second, next_seq++, false};
+        Push(record);
+        Remember(pair.first, &pair.second);
+
+        if (!top || top->first == pair.first) Settle();
+        else if (Less(Record{top->first, top->second, 0, false}, record)) SetTop(record, Buffer);
+    }
+
+    /**
+     * Complexity: that of InsertOrUpdate, or a lookup if key not found
+     */
+    void Erase(const K &key) override {
+        auto previous = Find(key);
+        if (!previous) return;
+        Push(Record{key, *previous, next_seq++, true});
+        Remember(key, nullptr);
+        --size;
+        if (top && top->first == key) Settle();
+    }
+
+    /**
+     * Complexity: a lookup
+     */
+    bool Contain(const K &key) const override {
+        return TryPeek(key) != nullptr;
+    }
+
+    /**
+     * In key order
+     * Complexity: O(N / B) I/Os, as it reads the whole key index
+     */
+    std::vector<K> Keys() const override {
+        std::vector<K> keys;
+        keys.reserve(size);
+        auto it = recent.begin();
+        Merge(0, tables.size(), [&](const Entry &entry) {
+            for (; it != recent.end() && it->first < entry.key; ++it)
+                if (!it->second.erased) keys.push_back(it->first);
+            // the recent updates hide the tables
+            if (it != recent.end() && !(entry.key < it->first)) return;
+            if (!entry.erased) keys.push_back(entry.key);
+        });
+        for (; it != recent.end(); ++it)
+            if (!it->second.erased) keys.push_back(it->first);
+        return keys;
+    }
+
+    /**
+     * Complexity: a lookup
+     */
+    const V &Peek(const K &key) const override {
+        auto value = TryPeek(key);
+        Assert (value);
+        return *value;
+    }
+
+    /**
+     * A lookup: O(lg(M)) among the recent updates, or else a read of one page from every table
+     * whose key range holds key, newest first, i.e. O(fanout * log_fanout(N / M)) pages at most.
+     * A value read from a table is kept until the next update, so lookups may run concurrently
+     * @return nullptr if key not found; valid until the next update
+     */
+    const V *TryPeek(const K &key) const override {
+        auto it = recent.find(key);
+        if (it != recent.end()) return it->second.erased ? nullptr : &it->second.value;
+        auto value = FindInTables(key);
+        if (!value) return nullptr;
+        std::lock_guard<std::mutex> lock{peeked_mutex};
+        return &peeked.emplace(key, *value).first->second;
+    }
+
+    /**
+     * Number of run files on disk, in priority order
+     */
+    size_t Runs() const { return runs.size(); }
+
+    /**
+     * Number of table files on disk, in key order
+     */
+    size_t Tables() const { return tables.size(); }
+
+private:
+    /**
+     * Where the top comes from: the insertion heap, or the run at this position
+     */
+    static constexpr size_t Buffer = static_cast<size_t>(-1);
+
+    /**
+     * Priority order; copies of the same pair come newest first, so that a tombstone precedes the copy it cancels
+     */
+    static bool Less(const Record &a, const Record &b) {
+        if (Base::notequal(a.value, b.value)) return Base::less(a.value, b.value);
+        if (a.key < b.key || b.key < a.key) return a.key < b.key;
+        return a.seq < b.seq;
+    }
+
+    static bool Greater(const Record &a, const Record &b) { return Less(b, a); }
+
+    /**
+     * Whether tombstone cancels record, which comes right after it
+     */
+    static bool Cancels(const Record &tombstone, const Record &record) {
+        return tombstone.erased && !record.erased && tombstone.key == record.key &&
+               Base::equal(tombstone.value, record.value);
+    }
+
+    static std::atomic<size_t> &Instances() {
+        static std::atomic<size_t> instances{0};
+        return instances;
+    }
+
+    /**
+     * Writes records in priority order, dropping every tombstone that meets its copy
+     */
+    class RunWriter {
+    public:
+        RunWriter(const std::string &path, size_t block_records) : writer{path, block_records} {}
+
+        void Append(const Record &record) {
+            if (held) {
+                const bool cancelled = Cancels(*held, record);
+                if (!cancelled) writer.Append(*held);
+                held.reset();
+                if (cancelled) return;
+            }
+            if (record.erased) held = record;
+            else writer.Append(record);
+        }
+
+        size_t Finish() {
+            if (held) writer.Append(*held);
+            return writer.Finish();
+        }
+
+    private:
+        external::RunWriter<Record> writer;
+        std::optional<Record> held;
+    };
+
+    /**
+     * Writes entries in key order, keeping the first key of every page
+     */
+    class TableWriter {
+    public:
+        TableWriter(const std::string &path, const ExternalSorted &queue)
+                : writer{path, queue.block_entries}, page_entries{queue.page_entries} {}
+
+        void Append(const Entry &entry) {
+            if (writer.Count() % page_entries == 0) fences.push_back(entry.key);
+            last = entry.key;
+            writer.Append(entry);
+        }
+
+        size_t Finish() { return writer.Finish(); }
+
+        std::vector<K> fences;
+        std::optional<K> last;
+
+    private:
+        external::RunWriter<Entry> writer;
+        size_t page_entries;
+    };
+
+    std::string NextPath() { return prefix + std::to_string(next_file++) + ".run"; }
+
+    void AddRun(const std::string &path, size_t count, size_t level) {
+        if (count > 0) runs.push_back(std::make_unique<Run>(path, count, block_records, level));
+        else std::remove(path.c_str());
+    }
+
+    void AddTable(const std::string &path, TableWriter &writer, size_t level, size_t position) {
+        const size_t count = writer.Finish();
+        if (count > 0) {
+            tables.insert(tables.begin() + position, std::make_unique<Table>(
+                    path, count, std::move(writer.fences), *writer.last, page_entries, level));
+        } else {
+            std::remove(path.c_str());
+        }
+    }
+
+    /**
+     * A copy of the current value of key, which TryPeek would not keep across updates
+     */
+    std::optional<V> Find(const K &key) const {
+        auto it = recent.find(key);
+        if (it != recent.end()) return it->second.erased ? std::nullopt : std::optional<V>{it->second.value};
+        return FindInTables(key);
+    }
+
+    /**
+     * The value of key in the newest table that has it
+     */
+    std::optional<V> FindInTables(const K &key) const {
+        std::vector<Entry> page;
+        for (auto table = tables.rbegin(); table != tables.rend(); ++table) {
+            if (auto entry = (*table)->Find(key, page))
+                return entry->erased ? std::nullopt : std::optional<V>{entry->value};
+        }
+        return std::nullopt;
+    }
+
+    void SetTop(const Record &record, size_t from) {
+        top.emplace(record.key, record.value);
+        source = from;
+    }
+
+    void Push(const Record &record) {
+        if (buffer.size() == buffer_capacity) Spill();
+        // grows on demand, as a small queue never needs its share of the budget, but never past it
+        if (buffer.size() == buffer.capacity())
+            buffer.reserve(std::min(buffer_capacity, std::max<size_t>(block_records, 2 * buffer.size())));
+        buffer.push_back(record);
+        std::push_heap(buffer.begin(), buffer.end(), Less);
+    }
+
+    /**
+     * Drops the head of the given source
+     */
+    void Advance(size_t from) {
+        if (from == Buffer) {
+            std::pop_heap(buffer.begin(), buffer.end(), Less);
+            buffer.pop_back();
+        } else {
+            runs[from]->Next();
+            if (runs[from]->Empty()) runs.erase(runs.begin() + from);
+        }
+    }
+
+    /**
+     * The greatest of the heads of the insertion heap and of the runs, and where it comes from
+     * @return nullptr if there is none
+     */
+    const Record *Head(size_t &from) const {
+        const Record *best = buffer.empty() ? nullptr : &buffer.front();
+        from = Buffer;
+        for (size_t i = 0; i < runs.size(); ++i) {
+            if (!best || Less(*best, runs[i]->Head())) {
+                best = &runs[i]->Head();
+                from = i;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * Finds the greatest head that is not a tombstone, dropping the tombstones along with their copies on the way.
+     * A copy that is no longer current has its tombstone right before it, so that head is the top
+     */
+    void Settle() {
+        size_t from;
+        while (const Record *best = Head(from)) {
+            if (!best->erased) {
+                SetTop(*best, from);
+                return;
+            }
+            const Record tombstone = *best;
+            Advance(from);
+            best = Head(from);
+            Assert (best && Cancels(tombstone, *best));
+            Advance(from);
+        }
+        top.reset();
+    }
+
+    /**
+     * Writes the insertion heap out as a run of level 0
+     */
+    void Spill() {
+        std::sort(buffer.begin(), buffer.end(), Greater);
+        const auto path = NextPath();
+        RunWriter writer{path, block_records};
+        for (const auto &record : buffer) writer.Append(record);
+        buffer.clear();
+        AddRun(path, writer.Finish(), 0);
+        for (size_t level = 0; MergeRuns(level); ++level) {}
+        Settle();
+    }
+
+    /**
+     * Merges the runs of level into one of the next level, once there are fanout of them
+     * @return whether they were merged
+     */
+    bool MergeRuns(size_t level) {
+        const auto of_level = [level](const std::unique_ptr<Run> &run) { return run->Level() == level; };
+        if (static_cast<size_t>(std::count_if(runs.begin(), runs.end(), of_level)) < options.fanout) return false;
+
+        auto split = std::stable_partition(runs.begin(), runs.end(), [&](const std::unique_ptr<Run> &run) {
+            return !of_level(run);
+        });
+        std::vector<std::unique_ptr<Run>> merged{std::make_move_iterator(split), std::make_move_iterator(runs.end())};
+        runs.erase(split, runs.end());
+
+        const auto path = NextPath();
+        RunWriter writer{path, block_records};
+        while (!merged.empty()) {
+            size_t from = 0;
+            for (size_t i = 1; i < merged.size(); ++i)
+                if (Less(merged[from]->Head(), merged[i]->Head())) from = i;
+            writer.Append(merged[from]->Head());
+            merged[from]->Next();
+            if (merged[from]->Empty()) merged.erase(merged.begin() + from);
+        }
+        AddRun(path, writer.Finish(), level + 1);
+        return true;
+    }
+
+    /**
+     * Records the new value of key among the recent updates, or its erasure if value is nullptr
+     */
+    void Remember(const K &key, const V *value) {
+        peeked.clear();
+        recent[key] = value ? Slot{*value, false} : Slot{V{}, true};
+        if (recent.size() == recent_capacity) Flush();
+    }
+
+    /**
+     * Writes the recent updates out as a table of level 0, the newest of all
+     */
+    void Flush() {
+        const auto path = NextPath();
+        TableWriter writer{path, *this};
+        for (const auto &entry : recent) {
+            // an erasure hides nothing if there is no older table
+            if (!(entry.second.erased && tables.empty()))
+                writer.Append(Entry{entry.first, entry.second.value, entry.second.erased});
+        }
+        recent.clear();
+        AddTable(path, writer, 0, tables.size());
+        for (size_t level = 0; MergeTables(level); ++level) {}
+    }
+
+    /**
+     * Merges the tables of level into one of the next level, once there are fanout of them.
+     * Tables are kept oldest first, i.e. by decreasing level, so those of a level are next to each other
+     * @return whether they were merged
+     */
+    bool MergeTables(size_t level) {
+        size_t first = 0;
+        while (first < tables.size() && tables[first]->Level() > level) ++first;
+        size_t last = first;
+        while (last < tables.size() && tables[last]->Level() == level) ++last;
+        if (last - first < options.fanout) return false;
+
+        const auto path = NextPath();
+        TableWriter writer{path, *this};
+        // an erasure hides nothing if there is no older table
+        const bool oldest = first == 0;
+        Merge(first, last, [&](const Entry &entry) {
+            if (!(entry.erased && oldest)) writer.Append(entry);
+        });
+        tables.erase(tables.begin() + first, tables.begin() + last);
+        AddTable(path, writer, level + 1, first);
+        return true;
+    }
+
+    /**
+     * Visits the newest entry of every key in the tables [first, last), in key order
+     */
+    template<typename Visit>
+    void Merge(size_t first, size_t last, Visit &&visit) const {
+        std::vector<TableReader> readers;
+        readers.reserve(last - first);
+        for (size_t i = first; i < last; ++i) readers.emplace_back(*tables[i], block_entries);
+        while (true) {
+            // newest first, so that it wins on equal keys
+            const Entry *best = nullptr;
+            for (auto reader = readers.rbegin(); reader != readers.rend(); ++reader)
+                if (!reader->Empty() && (!best || reader->Head().key < best->key)) best = &reader->Head();
+            if (!best) return;
+
+            const Entry entry = *best;
+            visit(entry);
+            for (auto &reader : readers)
+                if (!reader.Empty() && !(entry.key < reader.Head().key)) reader.Next();
+        }
+    }
+
+    ExternalOptions options;
+    size_t block_records;
+    size_t block_entries;
+    size_t page_entries;
+    size_t buffer_capacity;
+    size_t recent_capacity;
+    std::string prefix;
+    size_t next_file = 0;
+    uint64_t next_seq = 0;
+    size_t size = 0;
+
+    std::vector<Record> buffer;
+    std::vector<std::unique_ptr<Run>> runs;
+
+    Recent recent;
+    std::vector<std::unique_ptr<Table>> tables;
+    // values read from the tables by TryPeek, kept until the next update
+    mutable std::map<K, V> peeked;
+    mutable std::mutex peeked_mutex;
+
+    std::optional<std::pair<K, V>> top;
+    size_t source = Buffer;
+};
+
+#endif //HARA_EXTERNAL_SORTED_H
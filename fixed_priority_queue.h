@@ -0,0 +1,247 @@
+#ifndef HARA_FIXED_PRIORITY_QUEUE_H
+#define HARA_FIXED_PRIORITY_QUEUE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include "Utils.h"
+#include "views.h"
+
+/**
+ * Outcome of an update of a FixedPriorityQueue, which never throws nor allocates
+ */
+enum class FixedStatus {
+    Ok,
+    Full,       // the key is new, but Capacity keys are in the queue already
+    NotFound,   // no such key to erase
+    Empty,      // nothing to pop
+};
+
+namespace fixed {
+
+constexpr size_t NextPowerOfTwo(size_t n) {
+    size_t power = 1;
+    while (power < n) power *= 2;
+    return power;
+}
+
+/**
+ * The smallest unsigned type that holds every value up to max
+ */
+template<size_t max>
+using Unsigned = std::conditional_t<max <= std::numeric_limits<uint8_t>::max(), uint8_t,
+        std::conditional_t<max <= std::numeric_limits<uint16_t>::max(), uint16_t,
+                std::conditional_t<max <= std::numeric_limits<uint32_t>::max(), uint32_t, uint64_t>>>;
+
+}
+
+/**
+ * Queue of at most Capacity keys whose storage is all inside the object, so that it never allocates:
+ * an indexed binary heap of the pairs, and an open-addressed hash table from keys to heap positions,
+ * with linear probing and backward-shift deletion.
+ * Requires K and V to be default-constructible
+ * Complexity: Top O(1), updates and Pop O(lg(Capacity)), Contain and Peek O(1) on average
+ * @tparam K
+ * @tparam V
+ * @tparam Capacity
+ */
+template<typename K, typename V, size_t Capacity, typename Compare = std::less<V>, typename Hash = std::hash<K>>
+class FixedPriorityQueue {
+public:
+    static_assert(Capacity > 0, "FixedPriorityQueue needs room for one key at least");
+
+    /**
+     * The hash table is kept at most half full
+     */
+    static constexpr size_t TableSize = fixed::NextPowerOfTwo(2 * Capacity);
+
+    /**
+     * Heap positions are stored in the smallest type that fits, with its greatest value marking free slots
+     */
+    using Position = fixed::Unsigned<TableSize>;
+
+    static constexpr Position Free = std::numeric_limits<Position>::max();
+
+    FixedPriorityQueue() { table.fill(Free); }
+
+    /**
+     * Complexity: O(1)
+     */
+    const std::pair<K, V> &Top() const {
+        Assert (size > 0);
+        return heap[0].pair;
+    }
+
+    /**
+     * @return nullptr if empty
+     */
+    const std::pair<K, V> *TryTop() const { return size > 0 ? &heap[0].pair : nullptr; }
+
+    FixedStatus Pop() {
+        if (size == 0) return FixedStatus::Empty;
+        RemoveAt(0);
+        return FixedStatus::Ok;
+    }
+
+    bool Empty() const { return size == 0; }
+
+    size_t Size() const { return size; }
+
+    static constexpr size_t MaxSize() { return Capacity; }
+
+    /**
+     * @return FixedStatus::Full if the key is new and there is no room left, leaving the queue unchanged
+     */
+    FixedStatus InsertOrUpdate(std::pair<K, V> pair) {
+        size_t slot = Find(pair.first);
+        if (table[slot] != Free) {
+            const size_t pos = table[slot];
+            heap[pos].pair.second = std::move(pair.second);
+            Restore(pos);
+            return FixedStatus::Ok;
+        }
+        if (size == Capacity) return FixedStatus::Full;
+
+        const size_t pos = size++;
+        heap[pos].pair = std::move(pair);
+        Place(pos, slot);
+        SiftUp(pos);
+        return FixedStatus::Ok;
+    }
+
+    FixedStatus Erase(const K &key) {
+        const size_t slot = Find(key);
+        if (table[slot] == Free) return FixedStatus::NotFound;
+        RemoveAt(table[slot]);
+        return FixedStatus::Ok;
+    }
+
+    bool Contain(const K &key) const { return table[Find(key)] != Free; }
+
+    const V &Peek(const K &key) const {
+        auto value = TryPeek(key);
+        Assert (value);
+        return *value;
+    }
+
+    /**
+     * @return nullptr if key not found
+     */
+    const V *TryPeek(const K &key) const {
+        const size_t slot = Find(key);
+        return table[slot] == Free ? nullptr : &heap[table[slot]].pair.second;
+    }
+
+    /**
+     * The keys in heap order, without copying; invalidated by updates
+     */
+    auto KeysView() const {
+        return MakeProjectView<Key>(heap.begin(), heap.begin() + size);
+    }
+
+    void Clear() {
+        for (size_t pos = 0; pos < size; ++pos) table[heap[pos].slot] = Free;
+        size = 0;
+    }
+
+private:
+    struct Entry {
+        std::pair<K, V> pair;
+        Position slot;
+    };
+
+    struct Key {
+        const K &operator()(const Entry &entry) const { return entry.pair.first; }
+    };
+
+    static bool Less(const std::pair<K, V> &a, const std::pair<K, V> &b) {
+        return Compare()(a.second, b.second) || (!Compare()(b.second, a.second) && a.first < b.first);
+    }
+
+    static size_t Home(const K &key) { return Hash()(key) & (TableSize - 1); }
+
+    /**
+     * The slot holding key, or else the free slot where it would go
+     */
+    size_t Find(const K &key) const {
+        size_t slot = Home(key);
+        while (table[slot] != Free && !(heap[table[slot]].pair.first == key)) slot = (slot + 1) & (TableSize - 1);
+        return slot;
+    }
+
+    void Place(size_t pos, size_t slot) {
+        heap[pos].slot = static_cast<Position>(slot);
+        table[slot] = static_cast<Position>(pos);
+    }
+
+    void RemoveAt(size_t pos) {
+        Unlink(heap[pos].slot);
+        if (pos != --size) {
+            heap[pos] = std::move(heap[size]);
+            table[heap[pos].slot] = static_cast<Position>(pos);
+            Restore(pos);
+        }
+    }
+
+    /**
+     * Frees slot, then shifts back the following entries of its cluster that may not be past it
+     */
+    void Unlink(size_t slot) {
+        size_t next = slot;
+        while (true) {
+            next = (next + 1) & (TableSize - 1);
+            if (table[next] == Free) break;
+            const size_t home = Home(heap[table[next]].pair.first);
+            // the distance from home to next must cover slot for the entry to move there
+            if (((next - home) & (TableSize - 1)) >= ((next - slot) & (TableSize - 1))) {
+                Place(table[next], slot);
+                slot = next;
+            }
+        }
+        table[slot] = Free;
+    }
+
+    void Swap(size_t a, size_t b) {
+        std::swap(heap[a], heap[b]);
+        table[heap[a].slot] = static_cast<Position>(a);
+        table[heap[b].slot] = static_cast<Position>(b);
+    }
+
+    void SiftUp(size_t pos) {
+        while (pos > 0) {
+            const size_t parent = (pos - 1) / 2;
+            if (!Less(heap[parent].pair, heap[pos].pair)) break;
+            Swap(parent, pos);
+            pos = parent;
+        }
+    }
+
+    void SiftDown(size_t pos) {
+        while (true) {
+            size_t best = pos;
+            for (size_t child = 2 * pos + 1; child <= 2 * pos + 2 && child < size; ++child)
+                if (Less(heap[best].pair, heap[child].pair)) best = child;
+            if (best == pos) break;
+            Swap(pos, best);
+            pos = best;
+        }
+    }
+
+    /**
+     * Moves the entry at pos, whose value changed, to where it belongs
+     */
+    void Restore(size_t pos) {
+        if (pos > 0 && Less(heap[(pos - 1) / 2].pair, heap[pos].pair)) SiftUp(pos);
+        else SiftDown(pos);
+    }
+
+    std::array<Entry, Capacity> heap;
+    std::array<Position, TableSize> table;
+    size_t size = 0;
+};
+
+#endif //HARA_FIXED_PRIORITY_QUEUE_H
@@ -0,0 +1,11 @@
+#include <cstddef>
+#include <cstdint>
+#include "differential.h"
+
+/**
+ * libFuzzer entry point; seed it with corpus/differential
+ */
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    differential::RunAll(data, size);
+    return 0;
+}
@@ -0,0 +1,211 @@
+#ifndef HARA_NUMA_ARENA_H
+#define HARA_NUMA_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+#include "Utils.h"
+
+#if defined(SORTED_HAVE_NUMA)
+#include <numa.h>
+#include <sched.h>
+#endif
+
+/**
+ * Memory placement on NUMA nodes, through libnuma when built with SORTED_HAVE_NUMA and available at run time.
+ * Otherwise there is a single node 0, and memory comes from operator new.
+ */
+namespace numa {
+
+inline bool Available() {
+#if defined(SORTED_HAVE_NUMA)
+    static const bool available = numa_available() >= 0;
+    return available;
+#else
+    return false;
+#endif
+}
+
+/**
+ * IDs of the nodes memory may be allocated on, in increasing order; they need not be contiguous
+ */
+inline const std::vector<int> &NodeIds() {
+    static const std::vector<int> ids = [] {
+        std::vector<int> ids;
+#if defined(SORTED_HAVE_NUMA)
+        if (Available()) {
+            for (int node = 0; node <= numa_max_node(); ++node)
+                if (numa_bitmask_isbitset(numa_all_nodes_ptr, node)) ids.push_back(node);
+        }
+#endif
+        if (ids.empty()) ids.push_back(0);
+        return ids;
+    }();
+    return ids;
+}
+
+inline int Nodes() { return static_cast<int>(NodeIds().size()); }
+
+/**
+ * The node of the CPU the calling thread runs on
+ */
+inline int CurrentNode() {
+#if defined(SORTED_HAVE_NUMA)
+    if (Available()) {
+        const int cpu = sched_getcpu();
+        const int node = cpu < 0 ? -1 : numa_node_of_cpu(cpu);
+        if (node >= 0) return node;
+    }
+#endif
+    return 0;
+}
+
+/**
+ * Alignment of every block from Allocate, at least
+ */
+constexpr size_t Alignment = 64;
+
+/**
+ * Complexity: a system call with libnuma, as memory is mapped in whole pages
+ */
+inline void *Allocate(size_t bytes, int node) {
+#if defined(SORTED_HAVE_NUMA)
+    if (Available()) {
+        void *block = numa_alloc_onnode(bytes, node);
+        if (!block) throw std::bad_alloc();
+        return block;
+    }
+#endif
+    (void) node;
+    return ::operator new(bytes, std::align_val_t{Alignment});
+}
+
+inline void Free(void *block, size_t bytes) {
+#if defined(SORTED_HAVE_NUMA)
+    if (Available()) return numa_free(block, bytes);
+#endif
+    (void) bytes;
+    ::operator delete(block, std::align_val_t{Alignment});
+}
+
+}
+
+/**
+ * Memory of one backend instance, placed on one node.
+ * Small blocks are carved out of large chunks and recycled through per-size free lists,
+ * so that tree nodes cost no system call; larger ones are allocated on the node one by one.
+ * Not thread-safe, like the backend it serves.
+ */
+class NodeArena {
+public:
+    explicit NodeArena(int node = numa::CurrentNode(), size_t chunk_size = 1 << 20)
+            : node{node}, chunk_size{chunk_size}, free_lists(MaxSmall / Granularity + 1) {
+        Assert (chunk_size >= MaxSmall + numa::Alignment);
+    }
+
+    NodeArena(const NodeArena &) = delete;
+
+    NodeArena &operator=(const NodeArena &) = delete;
+
+    ~NodeArena() {
+        for (auto chunk : chunks) numa::Free(chunk, chunk_size);
+    }
+
+    /**
+     * Complexity: O(1), but for a new chunk or a large block
+     */
+    void *Allocate(size_t bytes, size_t alignment) {
+        Assert (alignment <= numa::Alignment);
+        const size_t size = Round(bytes);
+        if (size > MaxSmall) return numa::Allocate(size, node);
+
+        auto &free_list = free_lists[size / Granularity];
+        if (free_list && reinterpret_cast<uintptr_t>(free_list) % alignment == 0) {
+            void *block = free_list;
+            free_list = free_list->next;
+            return block;
+        }
+
+        uintptr_t begin = (cursor + alignment - 1) / alignment * alignment;
+        if (!cursor || begin + size > limit) {
+            chunks.push_back(numa::Allocate(chunk_size, node));
+            cursor = reinterpret_cast<uintptr_t>(chunks.back());
+            limit = cursor + chunk_size;
+            begin = cursor;
+        }
+        cursor = begin + size;
+        return reinterpret_cast<void *>(begin);
+    }
+
+    void Deallocate(void *block, size_t bytes) {
+        const size_t size = Round(bytes);
+        if (size > MaxSmall) return numa::Free(block, size);
+
+        auto &free_list = free_lists[size / Granularity];
+        free_list = new(block) FreeBlock{free_list};
+    }
+
+    int Node() const { return node; }
+
+private:
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    static constexpr size_t Granularity = 16;
+    static constexpr size_t MaxSmall = 4096;
+
+    static size_t Round(size_t bytes) {
+        return (std::max(bytes, size_t{1}) + Granularity - 1) / Granularity * Granularity;
+    }
+
+    int node;
+    size_t chunk_size;
+    std::vector<void *> chunks;
+    uintptr_t cursor = 0;
+    uintptr_t limit = 0;
+    std::vector<FreeBlock *> free_lists;
+};
+
+/**
+ * Allocator that places a container on its arena's node; rebound copies share the arena.
+ * Default-constructed, it places on the node of the calling thread.
+ * @tparam T
+ */
+template<typename T>
+class NodeAllocator {
+public:
+    using value_type = T;
+
+    NodeAllocator() : arena{std::make_shared<NodeArena>()} {}
+
+    explicit NodeAllocator(int node) : arena{std::make_shared<NodeArena>(node)} {}
+
+    explicit NodeAllocator(std::shared_ptr<NodeArena> arena) : arena{std::move(arena)} {}
+
+    template<typename U>
+    NodeAllocator(const NodeAllocator<U> &that) : arena{that.arena} {}
+
+    T *allocate(size_t n) { return static_cast<T *>(arena->Allocate(n * sizeof(T), alignof(T))); }
+
+    void deallocate(T *block, size_t n) { arena->Deallocate(block, n * sizeof(T)); }
+
+    int Node() const { return arena->Node(); }
+
+    template<typename U>
+    bool operator==(const NodeAllocator<U> &that) const { return arena == that.arena; }
+
+    template<typename U>
+    bool operator!=(const NodeAllocator<U> &that) const { return arena != that.arena; }
+
+private:
+    template<typename U>
+    friend class NodeAllocator;
+
+    std::shared_ptr<NodeArena> arena;
+};
+
+#endif //HARA_NUMA_ARENA_H
@@ -0,0 +1,182 @@
+#ifndef HARA_NUMA_PRIORITY_QUEUE_H
+#define HARA_NUMA_PRIORITY_QUEUE_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <vector>
+#include "numa_arena.h"
+#include "priority_queue_impl.h"
+
+/**
+ * A backend whose index and storage live in one NodeArena, i.e. on one NUMA node:
+ * that of the constructing thread, or the one its NodeAllocator was made for
+ * @tparam K
+ * @tparam V
+ */
+template<typename K, typename V, typename Layout = HeapLayout, typename Compare = std::less<V>,
+        typename Index = OrderedIndex>
+using NumaSorted = SortedEngine<K, V, Layout, Compare, Index, NodeAllocator<std::pair<const K, V>>>;
+
+/**
+ * Which shard owns a key
+ */
+template<typename K>
+struct HashPartition {
+    size_t operator()(const K &key, size_t shards) const { return std::hash<K>()(key) % shards; }
+};
+
+/**
+ * Thread-safe queue split into one shard per NUMA node, each placed on its node along with its lock.
+ * A key always belongs to the same shard, chosen by Partition, so that updates only lock that shard;
+ * threads get local accesses for the keys their node owns, e.g. with a Partition that maps keys to nodes.
+ * TryTop and TryPop give a global view: they lock every shard, in order, and compare the shards' tops.
+ * @tparam K
+ * @tparam V
+ */
+template<typename K, typename V, typename Layout = HeapLayout, typename Compare = std::less<V>,
+        typename Partition = HashPartition<K>>
+class NumaPriorityQueue {
+public:
+    using Queue = NumaSorted<K, V, Layout, Compare>;
+
+    /**
+     * @param shards one per node by default; shard i is placed on the node of index i modulo the number of nodes
+     */
+    explicit NumaPriorityQueue(size_t shards = numa::Nodes()) {
+        Assert (shards > 0);
+        const auto &nodes = numa::NodeIds();
+        for (size_t i = 0; i < shards; ++i) {
+            const int node = nodes[i % nodes.size()];
+            this->shards.emplace_back(new(numa::Allocate(sizeof(Shard), node)) Shard{node});
+        }
+    }
+
+    NumaPriorityQueue(const NumaPriorityQueue &) = delete;
+
+    NumaPriorityQueue &operator=(const NumaPriorityQueue &) = delete;
+
+    void InsertOrUpdate(std::pair<K, V> pair) {
+        auto &shard = Owner(pair.first);
+        std::lock_guard<std::mutex> lock{shard.mutex};
+        shard.queue.InsertOrUpdate(std::move(pair));
+    }
+
+    void Erase(const K &key) {
+        auto &shard = Owner(key);
+        std::lock_guard<std::mutex> lock{shard.mutex};
+        shard.queue.Erase(key);
+    }
+
+    bool Contain(const K &key) const {
+        auto &shard = Owner(key);
+        std::lock_guard<std::mutex> lock{shard.mutex};
+        return shard.queue.Contain(key);
+    }
+
+    /**
+     * @return a copy of the value, or nothing if key not found
+     */
+    std::optional<V> TryPeek(const K &key) const {
+        auto &shard = Owner(key);
+        std::lock_guard<std::mutex> lock{shard.mutex};
+        auto value = shard.queue.TryPeek(key);
+        if (!value) return std::nullopt;
+        return *value;
+    }
+
+    /**
+     * Sum of the shards' sizes, each read at a different time under concurrent updates
+     */
+    size_t Size() const {
+        size_t size = 0;
+        for (const auto &shard : shards) {
+            std::lock_guard<std::mutex> lock{shard->mutex};
+            size += shard->queue.Size();
+        }
+        return size;
+    }
+
+    bool Empty() const { return Size() == 0; }
+
+    /**
+     * Complexity: O(S) for S shards
+     * @return a copy of the global top element, or nothing if empty
+     */
+    std::optional<std::pair<K, V>> TryTop() const {
+        auto locks = LockAll();
+        auto shard = Best();
+        if (!shard) return std::nullopt;
+        return shard->queue.Top();
+    }
+
+    /**
+     * Complexity: O(S) for S shards, plus a pop from one of them
+     * @return the popped global top element, or nothing if empty
+     */
+    std::optional<std::pair<K, V>> TryPop() {
+        auto locks = LockAll();
+        auto shard = Best();
+        if (!shard) return std::nullopt;
+        auto top = shard->queue.Top();
+        shard->queue.Pop();
+        return top;
+    }
+
+    size_t Shards() const { return shards.size(); }
+
+    /**
+     * The shard that owns key
+     */
+    size_t ShardOf(const K &key) const { return Partition()(key, shards.size()); }
+
+    int NodeOf(size_t shard) const { return shards[shard]->node; }
+
+private:
+    struct alignas(numa::Alignment) Shard {
+        explicit Shard(int node) : node{node}, queue{NodeAllocator<std::pair<const K, V>>{node}} {}
+
+        const int node;
+        mutable std::mutex mutex;
+        Queue queue;
+    };
+
+    struct Unmap {
+        void operator()(Shard *shard) const {
+            shard->~Shard();
+            numa::Free(shard, sizeof(Shard));
+        }
+    };
+
+    Shard &Owner(const K &key) const { return *shards[ShardOf(key)]; }
+
+    std::vector<std::unique_lock<std::mutex>> LockAll() const {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(shards.size());
+        for (const auto &shard : shards) locks.emplace_back(shard->mutex);
+        return locks;
+    }
+
+    /**
+     * The shard with the greatest top, with every shard locked
+     */
+    Shard *Best() const {
+        Shard *best = nullptr;
+        for (const auto &shard : shards) {
+            auto top = shard->queue.TryTop();
+            if (!top) continue;
+            if (!best || Less(best->queue.Top(), *top)) best = shard.get();
+        }
+        return best;
+    }
+
+    static bool Less(const std::pair<K, V> &a, const std::pair<K, V> &b) {
+        return Compare()(a.second, b.second) || (!Compare()(b.second, a.second) && a.first < b.first);
+    }
+
+    std::vector<std::unique_ptr<Shard, Unmap>> shards;
+};
+
+#endif //HARA_NUMA_PRIORITY_QUEUE_H
@@ -7,6 +7,8 @@
 #include <set>
 #include <map>
 #include "Utils.h"
+#include "bulk_load.h"
+#include "views.h"
 
 template<typename Impl>
 class PriorityQueue {
@@ -16,8 +18,12 @@ public:
 
     PriorityQueue() : impl{new Impl} {};
 
+    /**
+     * Bulk loads the pairs in [begin, end); see DuplicatePolicy for repeated keys
+     */
     template<typename Iterator>
-    PriorityQueue(Iterator begin, Iterator end) : impl{new Impl{begin, end}} {}
+    PriorityQueue(Iterator begin, Iterator end, DuplicatePolicy policy = DuplicatePolicy::LastWins)
+            : impl{new Impl{begin, end, policy}} {}
 
     ~PriorityQueue() { delete impl; };
 
@@ -38,12 +44,75 @@ public:
     std::vector<K> Keys() const { return impl->Keys(); }
 
     /**
-     * throws exception if key not found
+     * fails Assert if key not found
      * @param key
      * @return
      */
     const V &Peek(const K &key) const { return impl->Peek(key); }
 
+    /**
+     * Never throws
+     * @return nullptr if empty
+     */
+    const std::pair<K, V> *TryTop() const { return impl->TryTop(); }
+
+    /**
+     * Never throws
+     * @param key
+     * @return nullptr if key not found
+     */
+    const V *TryPeek(const K &key) const { return impl->TryPeek(key); }
+
+    /**
+     * Views that walk the backend's storage without copying; invalidated by updates.
+     * Only for backends that support them, e.g. SortedEngine
+     */
+    auto KeysView() const { return impl->KeysView(); }
+
+    auto EntriesView() const { return impl->EntriesView(); }
+
+    /**
+     * @return the entries in priority order, top first
+     */
+    auto SortedEntriesView() const { return impl->SortedEntriesView(); }
+
+    /**
+     * Visits up to limit entries in key order after cursor, and advances it; may be resumed after updates
+     * @return the number of entries visited
+     */
+    template<typename Visit>
+    size_t ExportChunk(ExportCursor<K> &cursor, size_t limit, Visit &&visit) const {
+        return impl->ExportChunk(cursor, limit, std::forward<Visit>(visit));
+    }
+
+    /**
+     * Order statistics, only for backends that support them, e.g. BTreeSorted
+     * @return the position of key in priority order, 0 for the top; fails Assert if key not found
+     */
+    size_t Rank(const K &key) const { return impl->Rank(key); }
+
+    /**
+     * @return the number of pairs whose value v is within lo <= v <= hi
+     */
+    size_t CountInRange(const V &lo, const V &hi) const { return impl->CountInRange(lo, hi); }
+
+    /**
+     * @return the pair with i pairs before it in priority order; fails Assert unless i < Size()
+     */
+    const std::pair<K, V> &Select(size_t i) const { return impl->Select(i); }
+
+    /**
+     * Only for backends that support it, e.g. SnapshotSorted
+     * @return an immutable view that can be read from any thread
+     */
+    auto TakeSnapshot() const { return impl->TakeSnapshot(); }
+
+    /**
+     * Never blocks, unlike TakeSnapshot when the backend's reader slots are exhausted
+     * @return an empty optional if no snapshot can be taken now
+     */
+    auto TryTakeSnapshot() const { return impl->TryTakeSnapshot(); }
+
 private:
     Impl *const impl;
 };
@@ -1,6 +1,18 @@
 #ifndef HARA_PRIORITY_QUEUE_IMPL_H
 #define HARA_PRIORITY_QUEUE_IMPL_H
 
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <vector>
+#include "Utils.h"
+#include "bulk_load.h"
+#include "btree.h"
+#include "views.h"
+
 template<typename K, typename V, typename Compare = std::less<V>>
 class PriorityQueueImpl {
 public:
@@ -25,6 +37,10 @@ public:
 
     virtual const V &Peek(const K &key) const = 0;
 
+    virtual const std::pair<K, V> *TryTop() const = 0;
+
+    virtual const V *TryPeek(const K &key) const = 0;
+
     virtual std::vector<Key> Keys() const = 0;
 
 protected:
@@ -37,6 +53,8 @@ protected:
     static inline bool notequal(const V &a, const V &b) { return !equal(a, b); }
 
     struct Pair {
+        Pair() = default;
+
         explicit Pair(std::pair<K, V> x) : x{std::move(x)} {}
 
         std::pair<K, V> x;
@@ -57,75 +75,412 @@ protected:
         bool operator>(const Pair &that) const {
             return that < *this;
         }
+
+        /**
+         * Whether this pair still carries value, i.e. is not a stale copy
+         */
+        bool Holds(const V &value) const { return equal(x.second, value); }
+
+        /**
+         * Same order as operator<, on the entries of an index
+         */
+        static bool EntryLess(const std::pair<const K, V> &a, const std::pair<const K, V> &b) {
+            return less(a.second, b.second) || (equal(a.second, b.second) && a.first < b.first);
+        }
     };
 };
 
 /**
- * The pqueue should always be in a state where the top element is valid
- * @tparam K
- * @tparam V
+ * Index policies: how SortedEngine maps keys to their current values
  */
-template<typename K, typename V, typename Compare = std::less<V>>
-class PriorityQueueSorted : public PriorityQueueImpl<K, V, Compare> {
-public:
-    PriorityQueueSorted() = default;
+struct OrderedIndex {
+    template<typename K, typename V, typename Allocator>
+    using Map = std::map<K, V, std::less<K>, Allocator>;
+};
 
-    template<typename Iterator>
-    explicit PriorityQueueSorted(Iterator begin, Iterator end)
-            : queue{begin, end} {
-        for (auto it = begin; it != end; ++it) {
-            valid.emplace(*it);
+struct HashedIndex {
+    template<typename K, typename V, typename Allocator>
+    using Map = std::unordered_map<K, V, std::hash<K>, std::equal_to<K>, Allocator>;
+};
+
+/**
+ * Storage-layout policies: how SortedEngine keeps the pairs in priority order.
+ * A Storage is told about every pair that enters or leaves the index:
+ * Removed(entry) is called while entry is still in the index, Inserted(pair) once pair is,
+ * and Settle(index) at the end of every update. Pop() removes the top, Size() counts
+ * the pairs the storage holds, and Sorted(index) views the valid pairs in priority order.
+ */
+
+/**
+ * Binary max-heap with lazy deletion: stale pairs stay in the heap until they surface at the top,
+ * which is always kept valid
+ * Complexity: Top O(1), updates O(lg(N)), Pop amortized O(lg(N))
+ */
+struct HeapLayout {
+    template<typename Pair, typename Allocator>
+    class Storage {
+    public:
+        explicit Storage(const Allocator &allocator) : heap{allocator} {}
+
+        template<typename Index>
+        const Pair *Top(const Index &) const { return heap.empty() ? nullptr : &heap.front(); }
+
+        template<typename Entry>
+        void Removed(const Entry &) {}
+
+        void Inserted(Pair pair) {
+            heap.push_back(std::move(pair));
+            std::push_heap(heap.begin(), heap.end());
         }
-    }
 
-    ~PriorityQueueSorted() override = default;
+        void Pop() {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.pop_back();
+        }
 
-    /**
-     * Complexity: O(1)
-     */
-    const std::pair<K, V> &Top() const override {
-        Assert (!Empty());
-        return queue.top().x;
-    }
+        /**
+         * Stale pairs included
+         */
+        size_t Size() const { return heap.size(); }
+
+        /**
+         * Complexity: Amortized O(1)
+         */
+        template<typename Index>
+        void Settle(const Index &index) {
+            while (!heap.empty()) {
+                auto it = index.find(heap.front().x.first);
+                if (it == index.end() || !heap.front().Holds(it->second))
+                    // this is a spurious element
+                    Pop();
+                else break;
+            }
+        }
 
-    /**
-     * Complexity: Amortized O(1)
-     */
-    void Pop() override {
-        if (Empty()) return;
-        valid.erase(queue.top().x.first);
-        queue.pop();
-        PopTillValid();
-    }
+        /**
+         * @param sorted in descending order, hence a valid max-heap already
+         */
+        void Build(std::vector<Pair> &&sorted) { heap.assign(std::make_move_iterator(sorted.begin()),
+                                                             std::make_move_iterator(sorted.end())); }
+
+        /**
+         * Walks the heap in priority order without modifying it: a frontier holds the slots
+         * whose parents were visited already, and stale pairs are skipped
+         */
+        template<typename Index>
+        class SortedIterator {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = decltype(std::declval<const Pair &>().x);
+            using difference_type = std::ptrdiff_t;
+            using pointer = const value_type *;
+            using reference = const value_type &;
+
+            SortedIterator() = default;
+
+            SortedIterator(const std::vector<Pair, Allocator> &heap, const Index &index) : heap{&heap}, index{&index} {
+                if (!heap.empty()) frontier.push_back(0);
+                Skip(nullptr);
+            }
+
+            reference operator*() const { return (*heap)[frontier.front()].x; }
+
+            pointer operator->() const { return &**this; }
+
+            SortedIterator &operator++() {
+                const Pair &last = (*heap)[frontier.front()];
+                Advance();
+                Skip(&last);
+                return *this;
+            }
+
+            SortedIterator operator++(int) {
+                auto copy = *this;
+                ++*this;
+                return copy;
+            }
+
+            bool operator==(const SortedIterator &that) const {
+                return frontier.empty() ? that.frontier.empty() :
+                       !that.frontier.empty() && frontier.front() == that.frontier.front();
+            }
+
+            bool operator!=(const SortedIterator &that) const { return !(*this == that); }
+
+        private:
+            void Advance() {
+                auto less = [this](size_t a, size_t b) { return (*heap)[a] < (*heap)[b]; };
+                const size_t slot = frontier.front();
+                std::pop_heap(frontier.begin(), frontier.end(), less);
+                frontier.pop_back();
+                for (size_t child = 2 * slot + 1; child <= 2 * slot + 2 && child < heap->size(); ++child) {
+                    frontier.push_back(child);
+                    std::push_heap(frontier.begin(), frontier.end(), less);
+                }
+            }
+
+            /**
+             * Stale copies that still hold the current value surface right after the pair they copy
+             */
+            void Skip(const Pair *last) {
+                while (!frontier.empty()) {
+                    const Pair &pair = (*heap)[frontier.front()];
+                    auto it = index->find(pair.x.first);
+                    if (it != index->end() && pair.Holds(it->second) && !(last && pair == *last)) break;
+                    Advance();
+                }
+            }
+
+            const std::vector<Pair, Allocator> *heap = nullptr;
+            const Index *index = nullptr;
+            std::vector<size_t> frontier;
+        };
+
+        /**
+         * Complexity: O(k lg(k)) for the first k pairs, plus the stale pairs skipped
+         */
+        template<typename Index>
+        View<SortedIterator<Index>> Sorted(const Index &index) const {
+            return {SortedIterator<Index>{heap, index}, SortedIterator<Index>{}};
+        }
 
-    bool Empty() const override { return valid.empty(); }
+    private:
+        std::vector<Pair, Allocator> heap;
+    };
+};
 
-    size_t Size() const override { return valid.size(); }
+/**
+ * Red-black tree of the valid pairs
+ * Complexity: Top O(1), updates and Pop O(lg(N))
+ */
+struct SetLayout {
+    template<typename Pair, typename Allocator>
+    class Storage {
+    public:
+        explicit Storage(const Allocator &allocator) : set{allocator} {}
+
+        template<typename Index>
+        const Pair *Top(const Index &) const { return set.empty() ? nullptr : &*set.begin(); }
+
+        template<typename Entry>
+        void Removed(const Entry &entry) { set.erase(Pair{entry}); }
+
+        void Inserted(Pair pair) { set.insert(std::move(pair)); }
+
+        void Pop() { set.erase(set.begin()); }
+
+        size_t Size() const { return set.size(); }
+
+        template<typename Index>
+        void Settle(const Index &) {}
+
+        void Build(std::vector<Pair> &&sorted) { set.insert(sorted.begin(), sorted.end()); }
+
+        /**
+         * Complexity: O(1) per pair
+         */
+        template<typename Index>
+        auto Sorted(const Index &) const { return MakeProjectView<views::Unwrap>(set.begin(), set.end()); }
+
+    private:
+        std::set<Pair, std::greater<Pair>, Allocator> set;
+    };
+};
+
+/**
+ * B+-tree of the valid pairs, with wide cache-aligned nodes
+ * Requires K and V to be default-constructible
+ * Complexity: Top O(1), updates and Pop O(log_B(N))
+ */
+struct BTreeLayout {
+    template<typename Pair, typename Allocator>
+    class Storage {
+    public:
+        explicit Storage(const Allocator &allocator) : tree{allocator} {}
+
+        template<typename Index>
+        const Pair *Top(const Index &) const { return tree.empty() ? nullptr : &tree.front(); }
+
+        template<typename Entry>
+        void Removed(const Entry &entry) { tree.erase(Pair{entry}); }
+
+        void Inserted(Pair pair) { tree.insert(std::move(pair)); }
+
+        void Pop() { tree.erase(Pair{tree.front()}); }
+
+        size_t Size() const { return tree.size(); }
+
+        template<typename Index>
+        void Settle(const Index &) {}
+
+        void Build(std::vector<Pair> &&sorted) { tree.build(sorted.begin(), sorted.end()); }
+
+        /**
+         * Complexity: O(1) per pair
+         */
+        template<typename Index>
+        auto Sorted(const Index &) const { return MakeProjectView<views::Unwrap>(tree.begin(), tree.end()); }
+
+        /**
+         * Number of pairs before pair
+         * Complexity: O(log_B(N))
+         */
+        size_t Rank(const Pair &pair) const { return tree.rank(pair); }
+
+        /**
+         * Number of leading pairs for which before holds, as for std::partition_point
+         * Complexity: O(log_B(N))
+         */
+        template<typename Predicate>
+        size_t RankIf(Predicate before) const { return tree.rank_if(before); }
+
+        /**
+         * Complexity: O(log_B(N))
+         */
+        const Pair &Select(size_t i) const { return tree.select(i); }
+
+    private:
+        BTree<Pair, std::greater<Pair>, 512, Allocator> tree;
+    };
+};
+
+/**
+ * No storage besides the index, which is rescanned for the top when the cached one is removed.
+ * The rescan happens in Settle, so Top stays read-only and safe for concurrent const readers
+ * Complexity: Top O(1), Insert O(1), Pop O(N), and Erase or update O(N) if it removes the top, O(1) otherwise
+ */
+struct ScanLayout {
+    template<typename Pair, typename Allocator>
+    class Storage {
+    public:
+        explicit Storage(const Allocator &) {}
+
+        template<typename Index>
+        const Pair *Top(const Index &) const { return top ? &*top : nullptr; }
+
+        template<typename Entry>
+        void Removed(const Entry &entry) {
+            if (top && !(top->x.first < entry.first) && !(entry.first < top->x.first)) Invalidate();
+        }
+
+        void Inserted(Pair pair) {
+            if (cached && (!top || *top < pair)) top.emplace(std::move(pair));
+        }
+
+        void Pop() { Invalidate(); }
+
+        /**
+         * Holds no pairs of its own
+         */
+        size_t Size() const { return 0; }
+
+        /**
+         * Rescans for the top if the cached one was removed
+         */
+        template<typename Index>
+        void Settle(const Index &index) {
+            if (cached) return;
+            auto it = std::max_element(index.begin(), index.end(), Pair::EntryLess);
+            if (it != index.end()) top.emplace(*it);
+            cached = true;
+        }
+
+        void Build(std::vector<Pair> &&sorted) {
+            if (!sorted.empty()) top.emplace(std::move(sorted.front()));
+        }
+
+        /**
+         * Pointers to the index entries, sorted once when the view is created
+         */
+        template<typename Index>
+        class SortedEntries {
+            using Entries = std::vector<const typename Index::value_type *>;
+
+        public:
+            explicit SortedEntries(const Index &index) {
+                entries.reserve(index.size());
+                for (const auto &entry : index) entries.push_back(&entry);
+                std::sort(entries.begin(), entries.end(), [](const auto *a, const auto *b) {
+                    return Pair::EntryLess(*b, *a);
+                });
+            }
+
+            auto begin() const { return ProjectIterator<typename Entries::const_iterator, views::Deref>{entries.begin()}; }
+
+            auto end() const { return ProjectIterator<typename Entries::const_iterator, views::Deref>{entries.end()}; }
+
+        private:
+            Entries entries;
+        };
+
+        /**
+         * Complexity: O(N lg(N)) and N pointers upfront, as there is no order to walk
+         */
+        template<typename Index>
+        SortedEntries<Index> Sorted(const Index &index) const { return SortedEntries<Index>{index}; }
+
+    private:
+        void Invalidate() {
+            top.reset();
+            cached = false;
+        }
+
+        std::optional<Pair> top;
+        bool cached = true;
+    };
+};
+
+/**
+ * The index half of a backend: maps each key to its current value, and answers every query
+ * that needs no priority order. The backend built on it keeps the pairs in priority order.
+ * @tparam K
+ * @tparam V
+ * @tparam Compare orders the values
+ * @tparam Index OrderedIndex or HashedIndex
+ * @tparam Allocator rebound for the index
+ */
+template<typename K, typename V, typename Compare = std::less<V>,
+        typename Index = OrderedIndex, typename Allocator = std::allocator<std::pair<const K, V>>>
+class IndexedImpl : public PriorityQueueImpl<K, V, Compare> {
+protected:
+    using Pair = typename PriorityQueueImpl<K, V, Compare>::Pair;
+    using IndexAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<const K, V>>;
+    using PairAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Pair>;
+
+    explicit IndexedImpl(const Allocator &allocator) : valid{IndexAllocator{allocator}} {}
 
     /**
-     * Complexity: O(lg(N))
+     * Bulk load of the index: deduplicates keys according to policy and sorts on all cores
+     * Complexity: O(N lg(N) / P + N)
+     * @return the pairs in priority order, top first, for the storage to Build from
      */
-    void InsertOrUpdate(std::pair<K, V> pair) override {
-        auto it = valid.find(pair.first);
-        if (it == valid.end())
-            valid.emplace(pair);
-        else
-            it->second = pair.second;
-        queue.emplace(std::move(pair));
-        PopTillValid();
+    template<typename Iterator>
+    std::vector<Pair> Load(Iterator begin, Iterator end, DuplicatePolicy policy) {
+        auto pairs = Deduplicate<K, V>(begin, end, policy, PriorityQueueImpl<K, V, Compare>::less);
+        valid.insert(pairs.begin(), pairs.end());
+        std::vector<Pair> sorted;
+        sorted.reserve(pairs.size());
+        for (auto &pair : pairs) sorted.emplace_back(std::move(pair));
+        ParallelSort(sorted.begin(), sorted.end(), std::greater<Pair>());
+        return sorted;
     }
 
+public:
+    ~IndexedImpl() override = default;
+
     /**
-     * Complexity: O(lg(N))
+     * Complexity: that of TryTop
      */
-    void Erase(const K &key) override {
-        auto it = valid.find(key);
-        if (it == valid.end()) return;
-
-        valid.erase(it);
-        PopTillValid();
+    const std::pair<K, V> &Top() const override {
+        auto top = this->TryTop();
+        Assert (top);
+        return *top;
     }
 
+    bool Empty() const override { return valid.empty(); }
+
+    size_t Size() const override { return valid.size(); }
+
     /**
      * Complexity: O(lg(N))
      */
@@ -138,6 +493,7 @@ public:
     */
     std::vector<K> Keys() const override {
         std::vector<K> keys;
+        keys.reserve(valid.size());
         for (const auto &pair : valid) keys.push_back(pair.first);
         return keys;
     }
@@ -145,198 +501,202 @@ public:
     /**
      * Complexity: O(lg(N))
      */
-    const V &Peek(const K &key) const override { return valid.at(key); }
+    const V &Peek(const K &key) const override {
+        auto value = TryPeek(key);
+        Assert (value);
+        return *value;
+    }
 
-private:
     /**
-     * Complexity: Amortized O(1)
+     * Complexity: O(lg(N))
+     * @return nullptr if key not found
      */
-    void PopTillValid() {
-        while (!queue.empty()) {
-            auto it = valid.find(queue.top().x.first);
-            if (it == valid.end()
-                || PriorityQueueImpl<K, V, Compare>::notequal(it->second, queue.top().x.second))
-                // this is a spurious element
-                queue.pop();
-            else break;
-        }
+    const V *TryPeek(const K &key) const override {
+        auto it = valid.find(key);
+        return it == valid.end() ? nullptr : &it->second;
     }
 
-    using Pair = typename PriorityQueueImpl<K, V, Compare>::Pair;
-    std::priority_queue<Pair> queue;
-    std::map<K, V> valid;
+    /**
+     * The keys in index order, without copying; invalidated by updates
+     * Complexity: O(1) per key
+     */
+    auto KeysView() const { return MakeProjectView<views::First>(valid.begin(), valid.end()); }
+
+    /**
+     * The key-value entries in index order, without copying; invalidated by updates
+     * Complexity: O(1) per entry
+     */
+    auto EntriesView() const { return MakeView(valid.begin(), valid.end()); }
+
+    /**
+     * Streams the entries in key order, limit at a time, and may be resumed after updates;
+     * requires OrderedIndex
+     * Complexity: O(lg(N) + limit)
+     * @return the number of entries visited
+     */
+    template<typename Visit>
+    size_t ExportChunk(ExportCursor<K> &cursor, size_t limit, Visit &&visit) const {
+        return ::ExportChunk(valid, cursor, limit, std::forward<Visit>(visit));
+    }
+
+protected:
+    typename Index::template Map<K, V, IndexAllocator> valid;
 };
 
-template<typename K, typename V, typename Compare = std::less<V>>
-class SetSorted : public PriorityQueueImpl<K, V, Compare> {
+/**
+ * The single implementation behind every backend.
+ * An index maps each key to its current value, and a storage layout keeps the pairs in priority order.
+ * @tparam K
+ * @tparam V
+ * @tparam Layout HeapLayout, SetLayout, BTreeLayout or ScanLayout
+ * @tparam Compare orders the values
+ * @tparam Index OrderedIndex or HashedIndex
+ * @tparam Allocator rebound for both the index and the storage
+ */
+template<typename K, typename V, typename Layout, typename Compare = std::less<V>,
+        typename Index = OrderedIndex, typename Allocator = std::allocator<std::pair<const K, V>>>
+class SortedEngine : public IndexedImpl<K, V, Compare, Index, Allocator> {
+    using Base = IndexedImpl<K, V, Compare, Index, Allocator>;
+    using typename Base::Pair;
+    using typename Base::PairAllocator;
+    using Base::valid;
+
 public:
-    SetSorted() = default;
+    explicit SortedEngine(const Allocator &allocator = Allocator())
+            : Base{allocator}, storage{PairAllocator{allocator}} {}
 
+    /**
+     * Bulk load: deduplicates keys according to policy and sorts on all cores
+     * Complexity: O(N lg(N) / P + N)
+     */
     template<typename Iterator>
-    explicit SetSorted(Iterator begin, Iterator end)
-            : set{begin, end} {
-        for (auto it = begin; it != end; ++it)
-            valid.insert(*it);
+    explicit SortedEngine(Iterator begin, Iterator end, DuplicatePolicy policy = DuplicatePolicy::LastWins,
+                          const Allocator &allocator = Allocator())
+            : SortedEngine{allocator} {
+        storage.Build(this->Load(begin, end, policy));
     }
 
-    ~SetSorted() override = default;
+    ~SortedEngine() override = default;
 
     /**
-     * Complexity: O(1)
+     * Complexity: see Layout
+     * @return nullptr if empty
      */
-    const std::pair<K, V> &Top() const override {
-        Assert (!Empty());
-        return set.begin()->x;
+    const std::pair<K, V> *TryTop() const override {
+        auto top = storage.Top(valid);
+        return top ? &top->x : nullptr;
     }
 
     /**
-     * Complexity: O(lg(N))
+     * Complexity: see Layout
      */
     void Pop() override {
-        if (Empty()) return;
-        valid.erase(set.begin()->x.first);
-        set.erase(set.begin());
+        auto top = storage.Top(valid);
+        if (!top) return;
+        valid.erase(top->x.first);
+        storage.Pop();
+        storage.Settle(valid);
     }
 
-    bool Empty() const override { return set.empty(); }
-
-    size_t Size() const override { return set.size(); }
-
     /**
-     * Complexity: O(lg(N))
+     * Complexity: O(lg(N)) for the index, plus the layout's
      */
     void InsertOrUpdate(std::pair<K, V> pair) override {
         auto it = valid.find(pair.first);
         if (it == valid.end()) {
             valid.insert(pair);
-            set.emplace(std::move(pair));
         } else {
-            set.erase(Pair{*it});
+            storage.Removed(*it);
             it->second = pair.second;
-            set.emplace(std::move(pair));
         }
+        storage.Inserted(Pair{std::move(pair)});
+        storage.Settle(valid);
     }
 
     /**
-     * Complexity: O(lg(N))
+     * Complexity: O(lg(N)) for the index, plus the layout's
      */
     void Erase(const K &key) override {
         auto it = valid.find(key);
         if (it == valid.end()) return;
 
-        set.erase(Pair{*it});
+        storage.Removed(*it);
         valid.erase(it);
+        storage.Settle(valid);
     }
 
     /**
-     * Complexity: O(lg(N))
+     * The entries in priority order, top first; invalidated by updates
+     * Complexity: see Layout
      */
-    bool Contain(const K &key) const override {
-        return valid.find(key) != valid.end();
-    }
+    auto SortedEntriesView() const { return storage.Sorted(valid); }
 
     /**
-    * Complexity: O(N)
-    */
-    std::vector<K> Keys() const override {
-        std::vector<K> keys;
-        for (const auto &pair : valid) keys.push_back(pair.first);
-        return keys;
-    }
-
-    /**
-     * Complexity: O(lg(N))
+     * Position of key in priority order, 0 for the top; fails Assert if key not found.
+     * Requires a layout that counts its pairs, i.e. BTreeLayout
+     * Complexity: O(lg(N)) for the index, plus O(log_B(N))
      */
-    const V &Peek(const K &key) const override { return valid.at(key); }
-
-private:
-    using Pair = typename PriorityQueueImpl<K, V, Compare>::Pair;
-    std::set<Pair, std::greater<Pair>> set;
-    std::map<K, V> valid;
-};
-
-template<typename K, typename V, typename Compare = std::less<V>>
-class MapSorted : public PriorityQueueImpl<K, V, Compare> {
-public:
-    MapSorted() = default;
-
-    template<typename Iterator>
-    explicit MapSorted(Iterator begin, Iterator end) {
-        for (auto it = begin; it != end; ++it) {
-            map.emplace(it->first, *it);
-        }
+    size_t Rank(const K &key) const {
+        auto it = valid.find(key);
+        Assert (it != valid.end());
+        return storage.Rank(Pair{*it});
     }
 
-    ~MapSorted() override = default;
-
     /**
-     * Complexity: O(N)
+     * Number of pairs whose value v is within lo <= v <= hi; requires BTreeLayout
+     * Complexity: O(log_B(N))
      */
-    const std::pair<K, V> &Top() const override {
-        Assert (!Empty());
-        using pair = std::pair<const K, Pair>;
-        auto it = std::max_element(map.begin(), map.end(), [](const pair &a, const pair &b) {
-            return PriorityQueueImpl<K, V, Compare>::less(a.second.second, b.second.second) ||
-                   (PriorityQueueImpl<K, V, Compare>::equal(a.second.second, b.second.second) &&
-                    a.second.first < b.second.first);
+    size_t CountInRange(const V &lo, const V &hi) const {
+        const size_t above = storage.RankIf([&hi](const Pair &pair) {
+            return PriorityQueueImpl<K, V, Compare>::greater(pair.x.second, hi);
         });
-        return it->second;
-    }
-
-    /**
-     * Complexity: O(N)
-     */
-    void Pop() override {
-        if (Empty()) return;
-        const auto pair = Top();
-        map.erase(pair.first);
+        const size_t from_lo = storage.RankIf([&lo](const Pair &pair) {
+            return !PriorityQueueImpl<K, V, Compare>::less(pair.x.second, lo);
+        });
+        return from_lo > above ? from_lo - above : 0;
     }
 
-    bool Empty() const override { return map.empty(); }
-
-    size_t Size() const override { return map.size(); }
-
     /**
-     * Complexity: O(lg(N))
+     * The pair with i pairs before it in priority order; fails Assert unless i < Size(); requires BTreeLayout
+     * Complexity: O(log_B(N))
      */
-    void InsertOrUpdate(std::pair<K, V> pair) override {
-        auto it = map.find(pair.first);
-        if (it == map.end()) {
-            map.emplace(pair.first, pair);
-        } else {
-            it->second = pair;
-        }
+    const std::pair<K, V> &Select(size_t i) const {
+        Assert (i < valid.size());
+        return storage.Select(i).x;
     }
 
-    /**
-     * Complexity: O(lg(N))
-     */
-    void Erase(const K &key) override { map.erase(key); }
+private:
+    using Storage = typename Layout::template Storage<Pair, PairAllocator>;
+    Storage storage;
+};
 
-    /**
-     * Complexity: O(lg(N))
-     */
-    bool Contain(const K &key) const override {
-        return map.find(key) != map.end();
-    }
+/**
+ * The pqueue should always be in a state where the top element is valid
+ * @tparam K
+ * @tparam V
+ */
+template<typename K, typename V, typename Compare = std::less<V>>
+using PriorityQueueSorted = SortedEngine<K, V, HeapLayout, Compare>;
 
-    /**
-    * Complexity: O(N)
-    */
-    std::vector<K> Keys() const override {
-        std::vector<K> keys;
-        for (const auto &pair : map) keys.push_back(pair.first);
-        return keys;
-    }
+template<typename K, typename V, typename Compare = std::less<V>>
+using SetSorted = SortedEngine<K, V, SetLayout, Compare>;
 
-    /**
-     * Complexity: O(lg(N))
-     */
-    const V &Peek(const K &key) const override { return map.at(key).second; }
+/**
+ * Same as SetSorted, but ordered by a B+-tree with wide cache-aligned nodes.
+ * The tree counts its pairs, so it also answers Rank, CountInRange and Select in O(log_B(N))
+ * Requires K and V to be default-constructible
+ * @tparam K
+ * @tparam V
+ */
+template<typename K, typename V, typename Compare = std::less<V>>
+using BTreeSorted = SortedEngine<K, V, BTreeLayout, Compare>;
 
-private:
-    using Pair = std::pair<K, V>;
-    std::map<K, Pair> map;
-};
+/**
+ * Scans for the top, but caches it between updates
+ * @tparam K
+ * @tparam V
+ */
+template<typename K, typename V, typename Compare = std::less<V>>
+using MapSorted = SortedEngine<K, V, ScanLayout, Compare>;
 
 #endif //HARA_PRIORITY_QUEUE_IMPL_H
@@ -0,0 +1,590 @@
+#ifndef HARA_SNAPSHOT_SORTED_H
+#define HARA_SNAPSHOT_SORTED_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+#include "priority_queue_impl.h"
+
+namespace snapshot {
+
+/**
+ * Treap node. Once published, a node is never modified: an update copies the path down to what it changes
+ * and shares everything else with the previous version
+ */
+template<typename T>
+struct Node {
+    T item;
+    uint32_t priority;
+    Node *left;
+    Node *right;
+};
+
+/**
+ * Persistent treap operations, ordered by Less.
+ * Every node replaced by a copy is appended to retired, as it is still reachable from the previous version
+ */
+template<typename T, typename Less>
+struct Treap {
+    using Node = snapshot::Node<T>;
+
+    /**
+     * Builds a treap from items sorted by Less
+     * Complexity: O(N)
+     */
+    template<typename Random>
+    static Node *Build(std::vector<T> &&items, Random &random) {
+        // Cartesian tree on the priorities: the right spine is kept on a stack
+        std::vector<Node *> spine;
+        for (auto &item : items) {
+            Node *node = new Node{std::move(item), static_cast<uint32_t>(random()), nullptr, nullptr};
+            Node *last = nullptr;
+            while (!spine.empty() && spine.back()->priority < node->priority) {
+                last = spine.back();
+                spine.pop_back();
+            }
+            node->left = last;
+            if (!spine.empty()) spine.back()->right = node;
+            spine.push_back(node);
+        }
+        return spine.empty() ? nullptr : spine.front();
+    }
+
+    template<typename Probe>
+    static const T *Find(const Node *node, const Probe &probe) {
+        while (node) {
+            if (Less()(probe, node->item)) node = node->left;
+            else if (Less()(node->item, probe)) node = node->right;
+            else return &node->item;
+        }
+        return nullptr;
+    }
+
+    /**
+     * item must not be in the treap
+     * Complexity: expected O(lg(N))
+     */
+    static Node *Insert(Node *node, T item, uint32_t priority, std::vector<Node *> &retired) {
+        if (!node) return new Node{std::move(item), priority, nullptr, nullptr};
+        node = Copy(node, retired);
+        if (Less()(item, node->item)) {
+            node->left = Insert(node->left, std::move(item), priority, retired);
+            if (node->left->priority > node->priority) RotateRight(node);
+        } else {
+            node->right = Insert(node->right, std::move(item), priority, retired);
+            if (node->right->priority > node->priority) RotateLeft(node);
+        }
+        return node;
+    }
+
+    /**
+     * Replaces the item equivalent to probe, which must be in the treap, with item of the same order
+     * Complexity: expected O(lg(N))
+     */
+    template<typename Probe>
+    static Node *Replace(Node *node, const Probe &probe, T item, std::vector<Node *> &retired) {
+        node = Copy(node, retired);
+        if (Less()(probe, node->item)) node->left = Replace(node->left, probe, std::move(item), retired);
+        else if (Less()(node->item, probe)) node->right = Replace(node->right, probe, std::move(item), retired);
+        else node->item = std::move(item);
+        return node;
+    }
+
+    /**
+     * The item equivalent to probe must be in the treap
+     * Complexity: expected O(lg(N))
+     */
+    template<typename Probe>
+    static Node *Erase(Node *node, const Probe &probe, std::vector<Node *> &retired) {
+        if (Less()(probe, node->item)) {
+            Node *left = Erase(node->left, probe, retired);
+            node = Copy(node, retired);
+            node->left = left;
+        } else if (Less()(node->item, probe)) {
+            Node *right = Erase(node->right, probe, retired);
+            node = Copy(node, retired);
+            node->right = right;
+        } else {
+            retired.push_back(node);
+            node = Merge(node->left, node->right, retired);
+        }
+        return node;
+    }
+
+    static const Node *Front(const Node *node) {
+        if (node)
+            while (node->left) node = node->left;
+        return node;
+    }
+
+    /**
+     * Frees a whole version, which must not share any node with a live one
+     */
+    static void Destroy(Node *node) {
+        if (!node) return;
+        Destroy(node->left);
+        Destroy(node->right);
+        delete node;
+    }
+
+private:
+    static Node *Copy(Node *node, std::vector<Node *> &retired) {
+        retired.push_back(node);
+        return new Node{*node};
+    }
+
+    /**
+     * Both node and its child are fresh copies, so they can be relinked in place
+     */
+    static void RotateRight(Node *&node) {
+        Node *left = node->left;
+        node->left = left->right;
+        left->right = node;
+        node = left;
+    }
+
+    static void RotateLeft(Node *&node) {
+        Node *right = node->right;
+        node->right = right->left;
+        right->left = node;
+        node = right;
+    }
+
+    /**
+     * Every item of a precedes every item of b
+     */
+    static Node *Merge(Node *a, Node *b, std::vector<Node *> &retired) {
+        if (!a) return b;
+        if (!b) return a;
+        if (a->priority > b->priority) {
+            a = Copy(a, retired);
+            a->right = Merge(a->right, b, retired);
+            return a;
+        }
+        b = Copy(b, retired);
+        b->left = Merge(a, b->left, retired);
+        return b;
+    }
+};
+
+}
+
+/**
+ * Backend for a single writer and any number of lock-free readers.
+ *
+ * Every update publishes a new immutable version: two persistent treaps, one by key and one in priority order,
+ * that share all but O(lg(N)) nodes with the previous version. TakeSnapshot pins the current version
+ * in a reader slot, without blocking the writer nor being blocked by it, and reads it for as long as it lives.
+ * The nodes an update replaces are retired with the epoch of the version they belonged to,
+ * and freed by the writer once no reader slot is pinned at that epoch or earlier (epoch-based reclamation).
+ *
+ * The writer side (every PriorityQueueImpl method) must be used by one thread at a time;
+ * TakeSnapshot and Snapshot may be used from any thread. Snapshots must not outlive the queue.
+ * @tparam K
+ * @tparam V
+ * @tparam MaxReaders snapshots that may be alive at once
+ */
+template<typename K, typename V, typename Compare = std::less<V>, size_t MaxReaders = 64>
+class SnapshotSorted : public PriorityQueueImpl<K, V, Compare> {
+    using Pair = typename PriorityQueueImpl<K, V, Compare>::Pair;
+
+    struct KeyLess {
+        bool operator()(const std::pair<K, V> &a, const std::pair<K, V> &b) const { return a.first < b.first; }
+
+        bool operator()(const std::pair<K, V> &a, const K &b) const { return a.first < b; }
+
+        bool operator()(const K &a, const std::pair<K, V> &b) const { return a < b.first; }
+    };
+
+    using ByKey = snapshot::Treap<std::pair<K, V>, KeyLess>;
+    // in-order traversal yields the top first
+    using ByPriority = snapshot::Treap<Pair, std::greater<Pair>>;
+
+    struct Version {
+        typename ByKey::Node *by_key;
+        typename ByPriority::Node *by_priority;
+        const std::pair<K, V> *top;
+        size_t size;
+        uint64_t epoch;
+    };
+
+public:
+    /**
+     * Immutable view of the queue as of TakeSnapshot; holds its reader slot until destroyed
+     */
+    class Snapshot {
+    public:
+        /**
+         * Pairs in priority order, top first
+         */
+        class const_iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::pair<K, V>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const value_type *;
+            using reference = const value_type &;
+
+            const_iterator() = default;
+
+            reference operator*() const { return stack.back()->item.x; }
+
+            pointer operator->() const { return &stack.back()->item.x; }
+
+            const_iterator &operator++() {
+                auto node = stack.back();
+                stack.pop_back();
+                Descend(node->right);
+                return *this;
+            }
+
+            const_iterator operator++(int) {
+                auto it = *this;
+                ++*this;
+                return it;
+            }
+
+            bool operator==(const const_iterator &that) const {
+                return stack.empty() ? that.stack.empty() : !that.stack.empty() && stack.back() == that.stack.back();
+            }
+
+            bool operator!=(const const_iterator &that) const { return !(*this == that); }
+
+        private:
+            friend class Snapshot;
+
+            explicit const_iterator(const typename ByPriority::Node *root) { Descend(root); }
+
+            void Descend(const typename ByPriority::Node *node) {
+                for (; node; node = node->left) stack.push_back(node);
+            }
+
+            std::vector<const typename ByPriority::Node *> stack;
+        };
+
+        Snapshot(Snapshot &&that) noexcept : version{that.version}, slot{that.slot} { that.slot = nullptr; }
+
+        Snapshot(const Snapshot &) = delete;
+
+        Snapshot &operator=(const Snapshot &) = delete;
+
+        ~Snapshot() { if (slot) slot->store(0); }
+
+        /**
+         * Complexity: O(1)
+         */
+        const std::pair<K, V> &Top() const {
+            Assert (version->top);
+            return *version->top;
+        }
+
+        /**
+         * @return nullptr if empty
+         */
+        const std::pair<K, V> *TryTop() const { return version->top; }
+
+        /**
+         * The k greatest pairs, top first
+         * Complexity: O(k + lg(N))
+         */
+        std::vector<std::pair<K, V>> TopK(size_t k) const {
+            std::vector<std::pair<K, V>> pairs;
+            for (auto it = begin(); pairs.size() < k && it != end(); ++it) pairs.push_back(*it);
+            return pairs;
+        }
+
+        bool Empty() const { return version->size == 0; }
+
+        size_t Size() const { return version->size; }
+
+        /**
+         * Complexity: expected O(lg(N))
+         */
+        bool Contain(const K &key) const { return TryPeek(key) != nullptr; }
+
+        const V &Peek(const K &key) const {
+            auto value = TryPeek(key);
+            Assert (value);
+            return *value;
+        }
+
+        /**
+         * @return nullptr if key not found
+         */
+        const V *TryPeek(const K &key) const {
+            auto pair = ByKey::Find(version->by_key, key);
+            return pair ? &pair->second : nullptr;
+        }
+
+        /**
+         * Complexity: O(N)
+         */
+        std::vector<K> Keys() const {
+            std::vector<K> keys;
+            keys.reserve(version->size);
+            CollectKeys(version->by_key, keys);
+            return keys;
+        }
+
+        const_iterator begin() const { return const_iterator{version->by_priority}; }
+
+        const_iterator end() const { return const_iterator{}; }
+
+        /**
+         * Version number, one more for every update the writer published
+         */
+        uint64_t Epoch() const { return version->epoch; }
+
+    private:
+        friend class SnapshotSorted;
+
+        Snapshot(const Version *version, std::atomic<uint64_t> *slot) : version{version}, slot{slot} {}
+
+        static void CollectKeys(const typename ByKey::Node *node, std::vector<K> &keys) {
+            if (!node) return;
+            CollectKeys(node->left, keys);
+            keys.push_back(node->item.first);
+            CollectKeys(node->right, keys);
+        }
+
+        const Version *version;
+        std::atomic<uint64_t> *slot;
+    };
+
+    SnapshotSorted() { Init(nullptr, nullptr, 0); }
+
+    /**
+     * Bulk load: deduplicates keys according to policy and builds both treaps bottom-up
+     * Complexity: O(N lg(N) / P + N)
+     */
+    template<typename Iterator>
+    explicit SnapshotSorted(Iterator begin, Iterator end, DuplicatePolicy policy = DuplicatePolicy::LastWins) {
+        auto pairs = Deduplicate<K, V>(begin, end, policy, PriorityQueueImpl<K, V, Compare>::less);
+        std::vector<Pair> sorted;
+        sorted.reserve(pairs.size());
+        for (const auto &pair : pairs) sorted.emplace_back(pair);
+        ParallelSort(sorted.begin(), sorted.end(), std::greater<Pair>());
+
+        const size_t size = pairs.size();
+        auto by_key = ByKey::Build(std::move(pairs), random);
+        Init(by_key, ByPriority::Build(std::move(sorted), random), size);
+    }
+
+    SnapshotSorted(const SnapshotSorted &) = delete;
+
+    SnapshotSorted &operator=(const SnapshotSorted &) = delete;
+
+    ~SnapshotSorted() override {
+        while (!garbage.empty()) Free(garbage.front()), garbage.pop_front();
+        auto version = head.load();
+        ByKey::Destroy(version->by_key);
+        ByPriority::Destroy(version->by_priority);
+        delete version;
+    }
+
+    /**
+     * Pins the current version for reading; safe to call from any thread, concurrently with the writer.
+     * Yields until a reader slot frees up if all MaxReaders are taken, so a thread must not wait
+     * while holding MaxReaders snapshots itself
+     * Complexity: O(MaxReaders) per attempt
+     */
+    Snapshot TakeSnapshot() const {
+        for (;;) {
+            if (auto snapshot = TryTakeSnapshot()) return std::move(*snapshot);
+            std::this_thread::yield();
+        }
+    }
+
+    /**
+     * Never blocks
+     * Complexity: O(MaxReaders)
+     * @return nothing if all MaxReaders slots are taken
+     */
+    std::optional<Snapshot> TryTakeSnapshot() const {
+        // a stale epoch only pins more than needed; the version loaded after pinning is at least as recent
+        const uint64_t pin = epoch.load();
+        for (auto &slot : slots) {
+            uint64_t free = 0;
+            if (slot.compare_exchange_strong(free, pin)) return Snapshot{head.load(), &slot};
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * Complexity: O(1)
+     */
+    const std::pair<K, V> &Top() const override {
+        auto top = TryTop();
+        Assert (top);
+        return *top;
+    }
+
+    /**
+     * Complexity: O(1)
+     * @return nullptr if empty
+     */
+    const std::pair<K, V> *TryTop() const override { return Current()->top; }
+
+    /**
+     * Complexity: expected O(lg(N))
+     */
+    void Pop() override {
+        const Version *current = Current();
+        if (!current->top) return;
+        Garbage retired{current};
+        const K key = current->top->first;
+        Publish(ByKey::Erase(current->by_key, key, retired.by_key),
+                ByPriority::Erase(current->by_priority, Pair{*current->top}, retired.by_priority),
+                current->size - 1, std::move(retired));
+    }
+
+    bool Empty() const override { return Current()->size == 0; }
+
+    size_t Size() const override { return Current()->size; }
+
+    /**
+     * Complexity: expected O(lg(N))
+     */
+    void InsertOrUpdate(std::pair<K, V> pair) override {
+        const Version *current = Current();
+        Garbage retired{current};
+        auto by_key = current->by_key;
+        auto by_priority = current->by_priority;
+        auto size = current->size;
+
+        if (auto old = ByKey::Find(by_key, pair.first)) {
+            by_priority = ByPriority::Erase(by_priority, Pair{*old}, retired.by_priority);
+            by_key = ByKey::Replace(by_key, pair.first, pair, retired.by_key);
+        } else {
+            by_key = ByKey::Insert(by_key, pair, random(), retired.by_key);
+            ++size;
+        }
+        by_priority = ByPriority::Insert(by_priority, Pair{std::move(pair)}, random(), retired.by_priority);
+        Publish(by_key, by_priority, size, std::move(retired));
+    }
+
+    /**
+     * Complexity: expected O(lg(N))
+     */
+    void Erase(const K &key) override {
+        const Version *current = Current();
+        auto old = ByKey::Find(current->by_key, key);
+        if (!old) return;
+        Garbage retired{current};
+        auto by_priority = ByPriority::Erase(current->by_priority, Pair{*old}, retired.by_priority);
+        Publish(ByKey::Erase(current->by_key, key, retired.by_key), by_priority, current->size - 1,
+                std::move(retired));
+    }
+
+    /**
+     * Complexity: expected O(lg(N))
+     */
+    bool Contain(const K &key) const override { return TryPeek(key) != nullptr; }
+
+    /**
+     * Complexity: O(N)
+     */
+    std::vector<K> Keys() const override {
+        std::vector<K> keys;
+        keys.reserve(Current()->size);
+        Snapshot::CollectKeys(Current()->by_key, keys);
+        return keys;
+    }
+
+    /**
+     * Complexity: expected O(lg(N))
+     */
+    const V &Peek(const K &key) const override {
+        auto value = TryPeek(key);
+        Assert (value);
+        return *value;
+    }
+
+    /**
+     * Complexity: expected O(lg(N))
+     * @return nullptr if key not found
+     */
+    const V *TryPeek(const K &key) const override {
+        auto pair = ByKey::Find(Current()->by_key, key);
+        return pair ? &pair->second : nullptr;
+    }
+
+private:
+    /**
+     * Everything a version no longer shares with its successor
+     */
+    struct Garbage {
+        explicit Garbage(const Version *version) : version{version} {}
+
+        const Version *version;
+        std::vector<typename ByKey::Node *> by_key;
+        std::vector<typename ByPriority::Node *> by_priority;
+    };
+
+    /**
+     * Retired garbage is only reclaimed in batches, as it takes a pass over the reader slots
+     */
+    static constexpr size_t ReclaimBatch = 32;
+
+    void Init(typename ByKey::Node *by_key, typename ByPriority::Node *by_priority, size_t size) {
+        for (auto &slot : slots) slot.store(0);
+        epoch.store(1);
+        head.store(NewVersion(by_key, by_priority, size, 1));
+    }
+
+    static Version *NewVersion(typename ByKey::Node *by_key, typename ByPriority::Node *by_priority,
+                               size_t size, uint64_t epoch) {
+        auto front = ByPriority::Front(by_priority);
+        return new Version{by_key, by_priority, front ? &front->item.x : nullptr, size, epoch};
+    }
+
+    /**
+     * Only the writer reads head without pinning it, as only the writer frees versions
+     */
+    const Version *Current() const { return head.load(std::memory_order_relaxed); }
+
+    void Publish(typename ByKey::Node *by_key, typename ByPriority::Node *by_priority, size_t size,
+                 Garbage &&retired) {
+        const uint64_t next = retired.version->epoch + 1;
+        head.store(NewVersion(by_key, by_priority, size, next));
+        epoch.store(next);
+        garbage.push_back(std::move(retired));
+        if (garbage.size() >= ReclaimBatch) Reclaim();
+    }
+
+    /**
+     * Frees the garbage of every version older than all pinned ones
+     * Complexity: O(MaxReaders + freed nodes)
+     */
+    void Reclaim() {
+        uint64_t oldest = epoch.load();
+        for (const auto &slot : slots) {
+            const uint64_t pinned = slot.load();
+            if (pinned && pinned < oldest) oldest = pinned;
+        }
+        while (!garbage.empty() && garbage.front().version->epoch < oldest) {
+            Free(garbage.front());
+            garbage.pop_front();
+        }
+    }
+
+    static void Free(Garbage &retired) {
+        for (auto node : retired.by_key) delete node;
+        for (auto node : retired.by_priority) delete node;
+        delete retired.version;
+    }
+
+    std::atomic<const Version *> head;
+    std::atomic<uint64_t> epoch;
+    mutable std::atomic<uint64_t> slots[MaxReaders];
+
+    std::deque<Garbage> garbage;
+    std::mt19937 random;
+};
+
+#endif //HARA_SNAPSHOT_SORTED_H
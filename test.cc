@@ -1,5 +1,7 @@
 #include "priority_queue.h"
 #include "priority_queue_impl.h"
+#include "SortedItf.h"
+#include "SortedImpl.h"
 
 int main(int argc, const char** argv) {
     struct Data {
@@ -12,6 +14,9 @@ int main(int argc, const char** argv) {
     PriorityQueue<PriorityQueueSorted<int, Data, Compare>> queue1;
     PriorityQueue<SetSorted<int, Data, Compare>> queue2;
     PriorityQueue<MapSorted<int, Data, Compare>> queue3;
+    PriorityQueue<BTreeSorted<int, Data, Compare>> queue4;
+    PriorityQueue<SortedEngine<int, Data, SetLayout, Compare, HashedIndex>> queue5;
+    SortedInterface<PriorityQueueSorted<int, int>> queue6;
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <vector>
+#include "Utils.h"
+#include "adaptive_sorted.h"
+
+int main() {
+    constexpr int N = 1000;
+    constexpr size_t WINDOW = 256;
+    AdaptiveSorted<int, int, std::less<int>, WINDOW, 16> queue;
+    std::vector<MigrationEvent> events;
+    queue.OnMigration([&](const MigrationEvent &event) { events.push_back(event); });
+
+    // insert-only burst: rescanning for the top is never needed
+    for (int i = 0; i < N; ++i) queue.InsertOrUpdate({i, i});
+    for (size_t i = 0; i < 2 * WINDOW; ++i) queue.InsertOrUpdate({static_cast<int>(i % N), static_cast<int>(i)});
+    Assert (queue.Layout() == AdaptiveLayout::Scan && !queue.Migrating());
+    Assert (events.size() == 2 && events[0].phase == MigrationEvent::Started &&
+            events[0].from == AdaptiveLayout::Heap && events[0].to == AdaptiveLayout::Scan &&
+            events[1].phase == MigrationEvent::Finished && events[1].to == AdaptiveLayout::Scan);
+
+    // pop-heavy: back to the heap
+    for (size_t i = 0; i < 4 * WINDOW; ++i) {
+        queue.Pop();
+        queue.InsertOrUpdate({N + static_cast<int>(i), static_cast<int>(i)});
+    }
+    Assert (queue.Layout() == AdaptiveLayout::Heap && events.back().to == AdaptiveLayout::Heap);
+
+    // many updates per pop would pile stale copies up in the heap
+    for (size_t i = 0; i < 4 * WINDOW; ++i) {
+        queue.InsertOrUpdate({N + static_cast<int>(i % 100), static_cast<int>(i)});
+        if (i % 16 == 0) queue.Pop();
+    }
+    Assert (queue.Layout() == AdaptiveLayout::Set);
+
+    // migrating back to a layout that is still being drained waits for the drain, rather than finishing it at once
+    queue.Migrate(AdaptiveLayout::Heap);
+    while (queue.Migrating()) queue.InsertOrUpdate({N, 0});
+    queue.Migrate(AdaptiveLayout::Set);
+    Assert (queue.Migrating() && events.back().phase == MigrationEvent::Finished);
+    while (events.back().phase == MigrationEvent::Finished) queue.InsertOrUpdate({N, 0});
+    Assert (events.back().to == AdaptiveLayout::Set);
+    while (queue.Migrating()) queue.InsertOrUpdate({N, 0});
+    Assert (queue.Layout() == AdaptiveLayout::Set);
+
+    // migrations never change the contents
+    std::vector<std::pair<int, int>> pairs;
+    for (int key : queue.Keys()) pairs.emplace_back(key, queue.Peek(key));
+    queue.Migrate(AdaptiveLayout::Heap);
+    Assert (queue.Migrating());
+    for (size_t i = 0; queue.Migrating(); ++i) queue.InsertOrUpdate(pairs[i % pairs.size()]);
+    Assert (queue.Layout() == AdaptiveLayout::Heap && queue.Size() == pairs.size());
+    std::sort(pairs.begin(), pairs.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+        return a.second > b.second || (a.second == b.second && a.first > b.first);
+    });
+    for (const auto &pair : pairs) {
+        Assert (queue.Top() == pair);
+        queue.Pop();
+    }
+    Assert (queue.Empty());
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+#include "Utils.h"
+#include "bulk_load.h"
+#include "priority_queue.h"
+#include "priority_queue_impl.h"
+
+using pair = std::pair<int, int>;
+
+template<typename Impl>
+void CheckBulkLoad(const std::vector<pair> &pairs, DuplicatePolicy policy, const std::map<int, int> &expected) {
+    PriorityQueue<Impl> queue{pairs.begin(), pairs.end(), policy};
+    Assert (queue.Size() == expected.size());
+    for (const auto &p : expected) Assert (queue.Peek(p.first) == p.second);
+
+    std::vector<pair> sorted{expected.begin(), expected.end()};
+    std::sort(sorted.begin(), sorted.end(), [](const pair &a, const pair &b) {
+        return a.second > b.second || (a.second == b.second && a.first > b.first);
+    });
+    for (auto &p : sorted) {
+        Assert (queue.Top() == p);
+        queue.Pop();
+    }
+    Assert (queue.Empty());
+}
+
+std::map<int, int> Expected(const std::vector<pair> &pairs, DuplicatePolicy policy) {
+    std::map<int, int> expected;
+    for (auto &p : pairs) {
+        auto it = expected.emplace(p).first;
+        if (policy == DuplicatePolicy::LastWins || it->second < p.second) it->second = p.second;
+    }
+    return expected;
+}
+
+int main() {
+    constexpr int N = 100000;
+    std::mt19937 gen(0);
+    std::uniform_int_distribution<> key_dis{0, N / 3};
+    std::uniform_int_distribution<> val_dis{0, 1000};
+
+    std::vector<pair> pairs;
+    for (int i = 0; i < N; ++i) pairs.emplace_back(key_dis(gen), val_dis(gen));
+
+    // sorting on several threads matches sorting on one, even where the cores are few
+    auto by_key = [](const pair &a, const pair &b) { return a.first < b.first; };
+    auto stable = pairs;
+    std::stable_sort(stable.begin(), stable.end(), by_key);
+    for (size_t threads : {1, 2, 3, 4}) {
+        auto parallel = pairs;
+        ParallelStableSort(parallel.begin(), parallel.end(), by_key, threads);
+        Assert (parallel == stable);
+        parallel = pairs;
+        ParallelSort(parallel.begin(), parallel.end(), std::greater<pair>(), threads);
+        Assert (std::is_sorted(parallel.begin(), parallel.end(), std::greater<pair>()));
+    }
+
+    // MapSorted pops in O(N), so it only gets a prefix
+    const std::vector<pair> prefix{pairs.begin(), pairs.begin() + 2000};
+    for (auto policy : {DuplicatePolicy::LastWins, DuplicatePolicy::BestWins}) {
+        const auto expected = Expected(pairs, policy);
+        CheckBulkLoad<PriorityQueueSorted<int, int>>(pairs, policy, expected);
+        CheckBulkLoad<SetSorted<int, int>>(pairs, policy, expected);
+        CheckBulkLoad<BTreeSorted<int, int>>(pairs, policy, expected);
+        CheckBulkLoad<MapSorted<int, int>>(prefix, policy, Expected(prefix, policy));
+    }
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include <chrono>
+#include <cmath>
+#include <string>
+#include "Utils.h"
+#include "decaying_priority_queue.h"
+
+struct FakeClock {
+    using duration = std::chrono::milliseconds;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::time_point<FakeClock>;
+    static constexpr bool is_steady = true;
+
+    static time_point now() { return current; }
+
+    static time_point current;
+};
+
+FakeClock::time_point FakeClock::current{};
+
+template<template<typename, typename, typename> class Backend>
+void Run() {
+    using namespace std::chrono;
+    FakeClock::current = FakeClock::time_point{};
+    DecayingPriorityQueue<Backend, std::string, FakeClock> queue{std::log(2.0)};
+
+    // scores halve every second
+    queue.InsertOrUpdate("a", 8);
+    FakeClock::current += seconds{2};
+    queue.InsertOrUpdate("b", 4);
+    queue.InsertOrUpdate("c", 1, seconds{1});
+    Assert (queue.Top().first == "b");
+    Assert (std::abs(queue.Peek("a") - 2) < 1e-9 && std::abs(queue.Top().second - 4) < 1e-9);
+
+    // relative order is unaffected by the decay
+    FakeClock::current += milliseconds{500};
+    Assert (queue.Top().first == "b" && std::abs(queue.Peek("b") / queue.Peek("a") - 2) < 1e-9);
+
+    // c expires, and its stale deadline must not drop the update
+    queue.InsertOrUpdate("c", 100, seconds{3});
+    Assert (queue.Top().first == "c");
+    FakeClock::current += seconds{1};
+    Assert (queue.Sweep(10) == 0 && queue.Contain("c"));
+    FakeClock::current += seconds{2};
+    Assert (!queue.Contain("c") && queue.Top().first == "b");
+    Assert (queue.Size() == 2);
+
+    // expired entries below the top are only dropped by Sweep, within the budget
+    for (int i = 0; i < 10; ++i) queue.InsertOrUpdate(std::to_string(i), 0.001, seconds{1});
+    FakeClock::current += seconds{1};
+    Assert (queue.Size() == 12);
+    // the deadline of c comes first, and is stale since Top already dropped c
+    Assert (queue.Sweep(1) == 0);
+    Assert (queue.Sweep(4) == 4 && queue.Size() == 8);
+    Assert (queue.Sweep(100) == 6 && queue.Size() == 2);
+
+    queue.Pop();
+    Assert (queue.Top().first == "a");
+    queue.Erase("a");
+    Assert (queue.Empty());
+
+    // refreshing keys long before they expire does not pile up their stale deadlines
+    for (int i = 0; i < 1000; ++i) {
+        FakeClock::current += seconds{1};
+        queue.InsertOrUpdate("d", 1, hours{1});
+        queue.InsertOrUpdate("e", 2, hours{1});
+        Assert (queue.Deadlines() <= 2 * queue.Size() + 1);
+    }
+    FakeClock::current += hours{1};
+    Assert (queue.Sweep(100) == 2 && queue.Empty());
+}
+
+int main() {
+    Run<PriorityQueueSorted>();
+    Run<SetSorted>();
+    Run<BTreeSorted>();
+    Run<MapSorted>();
+
+    return 0;
+}
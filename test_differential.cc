@@ -0,0 +1,41 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+#include "differential.h"
+
+/**
+ * Replays the corpora given on the command line, then random sequences
+ */
+int main(int argc, const char **argv) {
+    constexpr int NUM_SEQUENCES = 200;
+    constexpr int NUM_OPERATIONS = 2000;
+
+    for (int i = 1; i < argc; ++i) {
+        for (const auto &entry : std::filesystem::directory_iterator(argv[i])) {
+            std::ifstream file{entry.path(), std::ios::binary};
+            const std::vector<uint8_t> data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+            differential::RunAll(data.data(), data.size());
+        }
+    }
+
+    std::mt19937 gen(0);
+    std::uniform_int_distribution<> byte_dis(0, 255);
+    for (int i = 0; i < NUM_SEQUENCES; ++i) {
+        // few keys pile up stale copies, many keys grow the trees
+        const int num_keys = i % 2 ? 4 : 256;
+        std::vector<uint8_t> data{static_cast<uint8_t>(byte_dis(gen))};
+        for (int j = 0; j < 2 * (data[0] & 7); ++j)
+            data.push_back(static_cast<uint8_t>(byte_dis(gen) % num_keys));
+        for (int j = 0; j < NUM_OPERATIONS; ++j) {
+            data.push_back(static_cast<uint8_t>(byte_dis(gen)));
+            data.push_back(static_cast<uint8_t>(byte_dis(gen) % num_keys));
+            data.push_back(static_cast<uint8_t>(byte_dis(gen)));
+        }
+        differential::RunAll(data.data(), data.size());
+    }
+
+    return 0;
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <random>
 #include <string>
 #include <unordered_map>
@@ -41,6 +42,8 @@ int main() {
         pqueue.Erase(vector[idx].first);
         set.Erase(vector[idx].first);
         smap.Erase(vector[idx].first);
+        Assert (!pqueue.TryPeek(vector[idx].first) && !set.TryPeek(vector[idx].first) &&
+                !smap.TryPeek(vector[idx].first));
         std::swap(vector[idx], vector.back());
         vector.pop_back();
     }
@@ -51,11 +54,15 @@ int main() {
     for (auto &p : vector) {
         Assert (!pqueue.Empty() && !set.Empty() && !smap.Empty());
         Assert (pqueue.Top() == p && set.Top() == p && smap.Top() == p);
+        Assert (*pqueue.TryTop() == p && *set.TryTop() == p && *smap.TryTop() == p);
+        Assert (*pqueue.TryPeek(p.first) == p.second && *set.TryPeek(p.first) == p.second &&
+                *smap.TryPeek(p.first) == p.second);
         pqueue.Pop();
         set.Pop();
         smap.Pop();
     }
     Assert (pqueue.Empty() && set.Empty() && smap.Empty());
+    Assert (!pqueue.TryTop() && !set.TryTop() && !smap.TryTop());
 
     return 0;
 }
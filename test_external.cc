@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+#include "Utils.h"
+#include "external_sorted.h"
+#include "priority_queue.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * A map, along with its pairs in priority order
+ */
+struct Model {
+    void Set(int key, int value) {
+        Erase(key);
+        map[key] = value;
+        order.emplace(value, key);
+    }
+
+    void Erase(int key) {
+        auto it = map.find(key);
+        if (it == map.end()) return;
+        order.erase({it->second, key});
+        map.erase(it);
+    }
+
+    std::pair<int, int> Top() const { return {order.rbegin()->second, order.rbegin()->first}; }
+
+    std::map<int, int> map;
+    std::set<std::pair<int, int>> order;
+};
+
+int main() {
+    const auto directory = fs::temp_directory_path() / "sorted_test_external";
+    fs::remove_all(directory);
+    fs::create_directories(directory);
+
+    // 64 records per block, 5 blocks for the insertion heap and as much for the recent updates, 16 entries per page
+    ExternalOptions options;
+    options.block_size = 64 * sizeof(external::Record<int, int>);
+    options.memory_budget = 10 * options.block_size;
+    options.page_size = 16 * sizeof(external::Entry<int, int>);
+    options.fanout = 4;
+    options.directory = directory.string();
+
+    std::mt19937 gen{0};
+    for (int num_keys : {16, 1000, 100000}) {
+        ExternalSorted<int, int> queue{options};
+        Model model;
+        std::uniform_int_distribution<int> key_dis{0, num_keys - 1};
+        std::uniform_int_distribution<int> value_dis{0, 99};
+        std::uniform_int_distribution<int> op_dis{0, 9};
+        size_t max_runs = 0;
+        size_t max_tables = 0;
+
+        for (int i = 0; i < 50000; ++i) {
+            const int key = key_dis(gen);
+            const int op = op_dis(gen);
+            if (op < 6) {
+                const int value = value_dis(gen);
+                queue.InsertOrUpdate({key, value});
+                model.Set(key, value);
+            } else if (op < 8) {
+                queue.Pop();
+                if (!model.map.empty()) model.Erase(model.Top().first);
+            } else {
+                queue.Erase(key);
+                model.Erase(key);
+            }
+
+            Assert (queue.Size() == model.map.size());
+            Assert (model.map.empty() ? !queue.TryTop() : queue.Top() == model.Top());
+            Assert (queue.Contain(key) == (model.map.count(key) == 1));
+            Assert (!queue.Contain(key) || queue.Peek(key) == model.map[key]);
+            max_runs = std::max(max_runs, queue.Runs());
+            max_tables = std::max(max_tables, queue.Tables());
+        }
+        Assert (max_runs > 1);
+        // only so many keys fit among the recent updates
+        Assert (num_keys < 1000 || max_tables > 1);
+
+        auto keys = queue.Keys();
+        Assert (keys.size() == model.map.size() && std::equal(keys.begin(), keys.end(), model.map.begin(),
+                [](int key, const std::pair<const int, int> &pair) { return key == pair.first; }));
+
+        while (!model.map.empty()) {
+            Assert (queue.Top() == model.Top());
+            model.Erase(queue.Top().first);
+            queue.Pop();
+        }
+        Assert (queue.Empty() && queue.Runs() == 0);
+    }
+
+    // a stale copy sorting right before the valid copy of its key must not hide it when spilled
+    {
+        ExternalSorted<int, int> queue{options};
+        queue.InsertOrUpdate({0, 50});
+        queue.InsertOrUpdate({1, 5});
+        queue.InsertOrUpdate({1, 4});
+        for (int i = 2; i < 1002; ++i) queue.InsertOrUpdate({i, 100 + i});
+        Assert (queue.Runs() > 0);
+        for (int i = 1001; i >= 2; --i, queue.Pop()) Assert (queue.Top().first == i);
+        Assert (queue.Top() == std::make_pair(0, 50));
+        queue.Pop();
+        Assert (queue.TryTop() && queue.Top() == std::make_pair(1, 4));
+        queue.Pop();
+        Assert (queue.Empty() && !queue.TryTop());
+    }
+
+    // values read from the tables stay put across lookups, which may run concurrently
+    {
+        ExternalSorted<int, int> queue{options};
+        for (int i = 0; i < 10000; ++i) queue.InsertOrUpdate({i, 2 * i});
+        Assert (queue.Tables() > 0);
+        const int &first = queue.Peek(0), &second = queue.Peek(1);
+        Assert (first == 0 && second == 2 && queue.Peek(0) != queue.Peek(1));
+        std::vector<std::thread> readers;
+        for (int r = 0; r < 4; ++r) {
+            readers.emplace_back([&queue, r] {
+                for (int i = r; i < 10000; i += 4) Assert (queue.Contain(i) && queue.Peek(i) == 2 * i);
+            });
+        }
+        for (auto &reader : readers) reader.join();
+    }
+
+    // bulk load through the facade, with the default options
+    std::vector<std::pair<int, int>> pairs;
+    for (int i = 0; i < 1000; ++i) pairs.emplace_back(i % 100, i);
+    {
+        PriorityQueue<ExternalSorted<int, int>> queue{pairs.begin(), pairs.end()};
+        Assert (queue.Size() == 100 && queue.Top() == std::make_pair(99, 999) && queue.Peek(0) == 900);
+        for (int i = 99; i >= 0; --i, queue.Pop()) Assert (queue.Top().first == i);
+        Assert (queue.Empty());
+    }
+
+    // every run file is removed along with its queue
+    {
+        ExternalSorted<int, int> queue{options};
+        for (int i = 0; i < 10000; ++i) queue.InsertOrUpdate({i, i});
+        Assert (queue.Runs() > 0 && !fs::is_empty(directory));
+    }
+    Assert (fs::is_empty(directory));
+    fs::remove_all(directory);
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <random>
+#include "Utils.h"
+#include "fixed_priority_queue.h"
+#include "priority_queue_impl.h"
+
+/**
+ * Sends every key to the same home slot, so that clusters and backward shifts are the rule
+ */
+struct Collide {
+    size_t operator()(int key) const { return key % 3; }
+};
+
+template<typename Fixed>
+void Compare(Fixed &fixed, int num_keys, unsigned seed) {
+    SetSorted<int, int> reference;
+    std::mt19937 gen{seed};
+    std::uniform_int_distribution<int> key_dis{0, num_keys - 1};
+    std::uniform_int_distribution<int> value_dis{0, 15};
+    std::uniform_int_distribution<int> op_dis{0, 3};
+
+    for (int i = 0; i < 100000; ++i) {
+        const int key = key_dis(gen);
+        switch (op_dis(gen)) {
+            case 0:
+            case 1: {
+                const int value = value_dis(gen);
+                const bool fits = reference.Contain(key) || reference.Size() < Fixed::MaxSize();
+                Assert (fixed.InsertOrUpdate({key, value}) == (fits ? FixedStatus::Ok : FixedStatus::Full));
+                if (fits) reference.InsertOrUpdate({key, value});
+                break;
+            }
+            case 2:
+                Assert (fixed.Erase(key) == (reference.Contain(key) ? FixedStatus::Ok : FixedStatus::NotFound));
+                reference.Erase(key);
+                break;
+            default:
+                Assert (fixed.Pop() == (reference.Empty() ? FixedStatus::Empty : FixedStatus::Ok));
+                reference.Pop();
+                break;
+        }
+
+        Assert (fixed.Size() == reference.Size());
+        Assert (reference.Empty() ? !fixed.TryTop() : fixed.Top() == reference.Top());
+        Assert (fixed.Contain(key) == reference.Contain(key));
+        Assert (!reference.Contain(key) || fixed.Peek(key) == reference.Peek(key));
+    }
+
+    size_t count = 0;
+    for (int key : fixed.KeysView()) count += reference.Contain(key);
+    Assert (count == reference.Size());
+    fixed.Clear();
+    Assert (fixed.Empty() && !fixed.Contain(key_dis(gen)));
+}
+
+int main() {
+    // the layout is computed at compile time
+    using Small = FixedPriorityQueue<int, int, 100>;
+    static_assert(Small::TableSize == 256 && std::is_same<Small::Position, uint16_t>::value);
+    static_assert(FixedPriorityQueue<int, int, 60>::TableSize == 128 &&
+                  std::is_same<FixedPriorityQueue<int, int, 60>::Position, uint8_t>::value);
+
+    Small small;
+    Compare(small, 50, 0);      // never full
+    Compare(small, 150, 1);     // often full
+    FixedPriorityQueue<int, int, 64, std::less<int>, Collide> colliding;
+    Compare(colliding, 100, 2);
+
+    FixedPriorityQueue<int, int, 2> tiny;
+    Assert (tiny.Pop() == FixedStatus::Empty && tiny.Erase(1) == FixedStatus::NotFound);
+    Assert (tiny.InsertOrUpdate({1, 1}) == FixedStatus::Ok && tiny.InsertOrUpdate({2, 2}) == FixedStatus::Ok);
+    Assert (tiny.InsertOrUpdate({3, 3}) == FixedStatus::Full && !tiny.Contain(3));
+    Assert (tiny.InsertOrUpdate({1, 5}) == FixedStatus::Ok && tiny.Top() == std::make_pair(1, 5));
+
+    return 0;
+}
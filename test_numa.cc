@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <set>
+#include <thread>
+#include <vector>
+#include "Utils.h"
+#include "numa_priority_queue.h"
+#include "priority_queue.h"
+
+int main() {
+    constexpr int NUM_THREADS = 4;
+    constexpr int N = 10000;
+
+    // node IDs may be sparse, so the last node is the greatest ID rather than Nodes() - 1
+    const auto &nodes = numa::NodeIds();
+    const int last_node = nodes.back();
+    Assert (numa::Nodes() == static_cast<int>(nodes.size()) && std::is_sorted(nodes.begin(), nodes.end()));
+    Assert (std::find(nodes.begin(), nodes.end(), numa::CurrentNode()) != nodes.end());
+
+    // small blocks are recycled, and aligned as requested
+    NodeArena arena{last_node};
+    void *a = arena.Allocate(40, 8);
+    void *b = arena.Allocate(40, 64);
+    Assert (reinterpret_cast<uintptr_t>(b) % 64 == 0);
+    arena.Deallocate(a, 40);
+    Assert (arena.Allocate(33, 16) == a);
+    void *large = arena.Allocate(1 << 16, 64);
+    arena.Deallocate(large, 1 << 16);
+    arena.Deallocate(b, 40);
+
+    // a backend placed on the last node
+    SetSorted<int, int> reference;
+    NumaSorted<int, int, BTreeLayout> placed{NodeAllocator<std::pair<const int, int>>{last_node}};
+    for (int i = 0; i < N; ++i) {
+        reference.InsertOrUpdate({i % 1000, i * 7919 % N});
+        placed.InsertOrUpdate({i % 1000, i * 7919 % N});
+        if (i % 3 == 0) {
+            reference.Pop();
+            placed.Pop();
+        }
+        Assert (reference.Size() == placed.Size() && (reference.Empty() || reference.Top() == placed.Top()));
+    }
+
+    // the facade default-constructs, on the current node
+    PriorityQueue<NumaSorted<int, int>> local;
+    local.InsertOrUpdate({1, 10});
+    local.InsertOrUpdate({2, 20});
+    Assert (local.Top().first == 2 && local.Size() == 2);
+
+    // more shards than nodes, filled by concurrent writers on disjoint keys
+    NumaPriorityQueue<int, int> queue{2 * nodes.size() + 1};
+    Assert (queue.Shards() == 2 * nodes.size() + 1 && !queue.TryTop() && !queue.TryPop());
+    for (size_t i = 0; i < queue.Shards(); ++i) Assert (queue.NodeOf(i) == nodes[i % nodes.size()]);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < NUM_THREADS; ++t) {
+        threads.emplace_back([&queue, t] {
+            for (int i = t; i < N; i += NUM_THREADS) queue.InsertOrUpdate({i, i % 100});
+            for (int i = t; i < N; i += NUM_THREADS)
+                if (i % 10 == 0) queue.Erase(i);
+        });
+    }
+    for (auto &thread : threads) thread.join();
+    Assert (queue.Size() == N - N / 10 && queue.Contain(1) && !queue.Contain(10) && *queue.TryPeek(99) == 99);
+
+    // the global view pops in priority order across the shards
+    std::set<int> popped;
+    auto last = *queue.TryTop();
+    while (auto top = queue.TryPop()) {
+        Assert (top->second < last.second || (top->second == last.second && top->first <= last.first));
+        Assert (popped.insert(top->first).second);
+        last = *top;
+    }
+    Assert (popped.size() == N - N / 10 && queue.Empty());
+
+    return 0;
+}
@@ -1,10 +1,40 @@
+#include <algorithm>
 #include <random>
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
-#include "SortedItf.h"
-#include "SortedImpl.h"
+#include <new>
+#include "fixed_priority_queue.h"
+#include "priority_queue.h"
+#include "priority_queue_impl.h"
 #include "Utils.h"
 
+// counts every allocation, to check which backends allocate while running
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+    ++allocations;
+    if (void *block = std::malloc(size ? size : 1)) return block;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *block) noexcept { std::free(block); }
+
+void operator delete(void *block, size_t) noexcept { std::free(block); }
+
+// over-aligned types such as the B+-tree nodes go through these
+void *operator new(size_t size, std::align_val_t alignment) {
+    ++allocations;
+    const auto align = static_cast<size_t>(alignment);
+    // aligned_alloc wants a size multiple of the alignment
+    if (void *block = std::aligned_alloc(align, (std::max(size, size_t{1}) + align - 1) / align * align)) return block;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *block, std::align_val_t) noexcept { std::free(block); }
+
+void operator delete(void *block, size_t, std::align_val_t) noexcept { std::free(block); }
+
 enum {
     INSERT = 0,
     ERASE = 1,
@@ -25,9 +55,14 @@ struct Operation {
 
 template<typename Sorted>
 std::vector<std::pair<std::string, int>>
-PerformOperations(Sorted &sorted, const std::vector<Operation> &ops, long long int &duration) {
-    auto start = std::chrono::high_resolution_clock::now();
+PerformOperations(Sorted &sorted, const std::vector<Operation> &ops, long long int &duration, size_t &allocated) {
     std::vector<std::pair<std::string, int>> result;
+    size_t num_results = 0;
+    for (auto &operation : ops) num_results += operation.op == TOP || operation.op == PEEK;
+    result.reserve(num_results);
+
+    const size_t before = allocations;
+    auto start = std::chrono::high_resolution_clock::now();
     for (auto &operation : ops) {
         const auto &key = keys[operation.key];
         switch (operation.op) {
@@ -56,6 +91,7 @@ PerformOperations(Sorted &sorted, const std::vector<Operation> &ops, long long i
     }
     auto end = std::chrono::high_resolution_clock::now();
     duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    allocated = allocations - before;
     return result;
 }
 
@@ -69,7 +105,7 @@ int main(int argc, const char** argv) {
     std::uniform_int_distribution<> char_dis(0, 25);
     std::uniform_int_distribution<> op_dis(0, PEEK);
     std::uniform_int_distribution<> val_dis{0, 100000000};
-    std::uniform_int_distribution<> idx_dis{0, NUM_KEYS};
+    std::uniform_int_distribution<> idx_dis{0, NUM_KEYS - 1};
 
     keys.reserve(NUM_KEYS);
     for (int i = 0; i < NUM_KEYS; ++i) {
@@ -91,19 +127,32 @@ int main(int argc, const char** argv) {
     }
 
     long long int duration;
-    SortedInterface<PriorityQueueSorted<std::string, int>> pqueue;
-    auto result1 = PerformOperations(pqueue, ops, duration);
-    std::cout << "pqueue: " << duration << "ms" << std::endl;
+    size_t allocated;
+    PriorityQueue<PriorityQueueSorted<std::string, int>> pqueue;
+    auto result1 = PerformOperations(pqueue, ops, duration, allocated);
+    std::cout << "pqueue: " << duration << "ms, " << allocated << " allocations" << std::endl;
+
+    PriorityQueue<SetSorted<std::string, int>> set;
+    auto result2 = PerformOperations(set, ops, duration, allocated);
+    std::cout << "set: " << duration << "ms, " << allocated << " allocations" << std::endl;
+
+    PriorityQueue<BTreeSorted<std::string, int>> btree;
+    auto result3 = PerformOperations(btree, ops, duration, allocated);
+    std::cout << "btree: " << duration << "ms, " << allocated << " allocations" << std::endl;
 
-    SortedInterface<SetSorted<std::string, int>> set;
-    auto result2 = PerformOperations(set, ops, duration);
-    std::cout << "set: " << duration << "ms" << std::endl;
+    // too large for the stack; the keys are short enough for std::string not to allocate either
+    static FixedPriorityQueue<std::string, int, NUM_KEYS> fixed;
+    auto result4 = PerformOperations(fixed, ops, duration, allocated);
+    std::cout << "fixed: " << duration << "ms, " << allocated << " allocations" << std::endl;
+    Assert(allocated == 0);
 
-//    SortedInterface<MapSorted<std::string, int>> map;
-//    auto result3 = PerformOperations(map, ops, duration);
-//    std::cout << "map: " << duration << "ms" << std::endl;
+//    PriorityQueue<MapSorted<std::string, int>> map;
+//    auto result5 = PerformOperations(map, ops, duration, allocated);
+//    std::cout << "map: " << duration << "ms, " << allocated << " allocations" << std::endl;
 
     Assert(result1 == result2);
+    Assert(result1 == result3);
+    Assert(result1 == result4);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <set>
+#include "Utils.h"
+#include "btree.h"
+#include "priority_queue.h"
+#include "priority_queue_impl.h"
+
+/**
+ * Checks every rank and selection against the sorted contents
+ */
+template<typename Tree>
+void CheckTree(const Tree &tree, const std::set<int> &reference) {
+    Assert (tree.size() == reference.size());
+    size_t i = 0;
+    for (int x : reference) {
+        Assert (tree.select(i) == x && tree.rank(x) == i && tree.rank(x + 1) == i + 1);
+        ++i;
+    }
+    for (int x : {-1, 1 << 30}) Assert (tree.rank(x) == static_cast<size_t>(std::distance(reference.begin(), reference.lower_bound(x))));
+}
+
+int main() {
+    // small nodes, for a deep tree that splits, borrows and merges often
+    std::mt19937 gen{0};
+    BTree<int, std::less<int>, 64> tree;
+    std::set<int> reference;
+    std::uniform_int_distribution<int> dis{0, 2000};
+    for (int round = 0; round < 20; ++round) {
+        for (int i = 0; i < 1000; ++i) {
+            const int x = 2 * dis(gen);
+            Assert (tree.insert(x) == reference.insert(x).second);
+        }
+        CheckTree(tree, reference);
+        for (int i = 0; i < 1000; ++i) {
+            const int x = 2 * dis(gen);
+            Assert (tree.erase(x) == (reference.erase(x) == 1));
+        }
+        CheckTree(tree, reference);
+    }
+    std::vector<int> sorted{reference.begin(), reference.end()};
+    tree.build(sorted.begin(), sorted.end());
+    CheckTree(tree, reference);
+
+    // the backend, against a sorted copy of its pairs
+    PriorityQueue<BTreeSorted<int, int>> queue;
+    std::uniform_int_distribution<int> key_dis{0, 999};
+    std::uniform_int_distribution<int> value_dis{0, 99};
+    for (int i = 0; i < 20000; ++i) {
+        if (i % 4 == 3) queue.Pop();
+        else queue.InsertOrUpdate({key_dis(gen), value_dis(gen)});
+
+        if (i % 1000 != 999) continue;
+        std::vector<std::pair<int, int>> pairs;
+        for (int key : queue.Keys()) pairs.emplace_back(key, queue.Peek(key));
+        std::sort(pairs.begin(), pairs.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+            return a.second > b.second || (a.second == b.second && a.first > b.first);
+        });
+        for (size_t j = 0; j < pairs.size(); ++j)
+            Assert (queue.Select(j) == pairs[j] && queue.Rank(pairs[j].first) == j);
+
+        const int lo = value_dis(gen), hi = value_dis(gen);
+        const auto count = std::count_if(pairs.begin(), pairs.end(), [lo, hi](const std::pair<int, int> &pair) {
+            return lo <= pair.second && pair.second <= hi;
+        });
+        Assert (queue.CountInRange(lo, hi) == static_cast<size_t>(count));
+        Assert (queue.CountInRange(0, 99) == queue.Size() && queue.CountInRange(100, 200) == 0);
+    }
+
+    return 0;
+}
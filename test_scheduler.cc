@@ -0,0 +1,96 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "Utils.h"
+#include "concurrent_priority_queue.h"
+#include "priority_queue_impl.h"
+
+#if defined(__cpp_impl_coroutine)
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return {}; }
+
+        std::suspend_never initial_suspend() { return {}; }
+
+        std::suspend_never final_suspend() noexcept { return {}; }
+
+        void return_void() {}
+
+        void unhandled_exception() { throw; }
+    };
+};
+
+template<typename Queue>
+Task Consume(Queue &queue, std::vector<int> &popped, int count) {
+    for (int i = 0; i < count; ++i) {
+        auto pair = co_await queue.co_pop();
+        popped.push_back(pair.second);
+    }
+}
+#endif
+
+int main() {
+    using namespace std::chrono;
+    constexpr int NUM_PRODUCERS = 4;
+    constexpr int NUM_CONSUMERS = 4;
+    constexpr int N = 10000;
+
+    ConcurrentPriorityQueue<PriorityQueueSorted<int, int>> queue;
+    Assert (!queue.TryPop() && !queue.TryTop());
+    Assert (!queue.PopWait(milliseconds{10}));
+
+    queue.InsertOrUpdate({1, 10});
+    queue.InsertOrUpdate({2, 20});
+    Assert (queue.TryTop()->first == 2 && queue.TryPop()->first == 2);
+    Assert (queue.PopWait(milliseconds{10})->first == 1 && queue.Empty());
+    // the deadline is capped rather than overflowing
+    queue.InsertOrUpdate({3, 30});
+    Assert (queue.PopWait(hours::max())->first == 3 && queue.Empty());
+
+    // every element is popped by exactly one consumer
+    std::vector<std::atomic<int>> seen(NUM_PRODUCERS * N);
+    std::atomic<int> consumed{0};
+    std::vector<std::thread> threads;
+    for (int c = 0; c < NUM_CONSUMERS; ++c) {
+        threads.emplace_back([&] {
+            while (consumed < NUM_PRODUCERS * N) {
+                if (auto pair = queue.PopWait(milliseconds{10})) {
+                    ++seen[pair->first];
+                    ++consumed;
+                }
+            }
+        });
+    }
+    for (int p = 0; p < NUM_PRODUCERS; ++p) {
+        threads.emplace_back([&, p] {
+            std::vector<std::pair<int, int>> batch;
+            for (int i = 0; i < N; ++i) {
+                const int key = p * N + i;
+                if (i % 2) queue.InsertOrUpdate({key, key});
+                else batch.emplace_back(key, key);
+                if (batch.size() == 64 || i == N - 1) {
+                    queue.InsertOrUpdate(batch.begin(), batch.end());
+                    batch.clear();
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) thread.join();
+    for (auto &count : seen) Assert (count == 1);
+    Assert (queue.Empty());
+
+#if defined(__cpp_impl_coroutine)
+    // a suspended coroutine is resumed with each new element
+    std::vector<int> popped;
+    queue.InsertOrUpdate({0, 5});
+    Consume(queue, popped, 3);
+    Assert (popped.size() == 1 && popped[0] == 5);
+    std::vector<std::pair<int, int>> batch{{1, 1}, {2, 3}, {3, 2}};
+    queue.InsertOrUpdate(batch.begin(), batch.end());
+    Assert (popped.size() == 3 && popped[1] == 3 && popped[2] == 2);
+    Assert (queue.Size() == 1 && queue.TryPop()->second == 1);
+#endif
+
+    return 0;
+}
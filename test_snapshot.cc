@@ -0,0 +1,87 @@
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "Utils.h"
+#include "concurrent_priority_queue.h"
+#include "snapshot_sorted.h"
+
+int main() {
+    constexpr int NUM_KEYS = 100;
+    constexpr int NUM_READERS = 4;
+    constexpr int N = 20000;
+
+    PriorityQueue<SnapshotSorted<int, int>> queue;
+    for (int i = 0; i < NUM_KEYS; ++i) queue.InsertOrUpdate({i, i});
+
+    // a snapshot does not see later updates
+    auto before = queue.TakeSnapshot();
+    queue.InsertOrUpdate({0, 1000});
+    queue.Erase(50);
+    queue.Pop();
+    queue.InsertOrUpdate({NUM_KEYS, -1});
+    auto after = queue.TakeSnapshot();
+    Assert (after.Epoch() == before.Epoch() + 4);
+
+    Assert (before.Size() == NUM_KEYS && before.Top().first == NUM_KEYS - 1);
+    Assert (before.Peek(0) == 0 && before.Contain(50) && !before.Contain(NUM_KEYS));
+    Assert (before.Keys().size() == NUM_KEYS);
+    auto top = before.TopK(3);
+    Assert (top.size() == 3 && top[0].first == 99 && top[1].first == 98 && top[2].first == 97);
+    int expected = NUM_KEYS - 1;
+    for (const auto &pair : before) Assert (pair.first == expected-- && pair.second == pair.first);
+    Assert (expected == -1);
+
+    Assert (after.Size() == NUM_KEYS - 1 && after.Top() == std::make_pair(99, 99));
+    Assert (!after.Contain(50) && !after.Contain(0) && after.Peek(NUM_KEYS) == -1);
+    Assert (after.TopK(2 * NUM_KEYS).size() == after.Size());
+    Assert (!after.TryPeek(0) && !queue.Contain(0));
+
+    // readers see consistent versions while the writer keeps going
+    ConcurrentPriorityQueue<SnapshotSorted<int, int>> shared;
+    std::atomic<bool> done{false};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < NUM_READERS; ++r) {
+        readers.emplace_back([&] {
+            uint64_t epoch = 0;
+            while (!done) {
+                auto snapshot = shared.TakeSnapshot();
+                Assert (snapshot.Epoch() >= epoch);
+                epoch = snapshot.Epoch();
+
+                size_t count = 0;
+                const std::pair<int, int> *last = nullptr;
+                for (const auto &pair : snapshot) {
+                    Assert (pair.second % NUM_KEYS == pair.first && snapshot.Peek(pair.first) == pair.second);
+                    Assert (!last || last->second > pair.second);
+                    last = &pair;
+                    ++count;
+                }
+                Assert (count == snapshot.Size() && snapshot.Keys().size() == count);
+                Assert (snapshot.Empty() || *snapshot.TryTop() == snapshot.TopK(1)[0]);
+            }
+        });
+    }
+    for (int i = 0; i < N; ++i) {
+        const int key = i * 7 % NUM_KEYS;
+        if (i % 5 == 4) shared.TryPop();
+        else if (i % 11 == 10) shared.Erase(key);
+        else shared.InsertOrUpdate({key, i * NUM_KEYS + key});
+    }
+    done = true;
+    for (auto &reader : readers) reader.join();
+    Assert (shared.TakeSnapshot().Epoch() > N / 2);
+
+    // with every reader slot taken, TryTakeSnapshot fails and TakeSnapshot waits for a slot to free up
+    PriorityQueue<SnapshotSorted<int, int, std::less<int>, 2>> few;
+    few.InsertOrUpdate({0, 0});
+    std::optional<decltype(few.TakeSnapshot())> first{few.TakeSnapshot()};
+    auto second = few.TakeSnapshot();
+    Assert (!few.TryTakeSnapshot());
+    std::thread releaser{[&] { first.reset(); }};
+    auto third = few.TakeSnapshot();
+    releaser.join();
+    Assert (third.Size() == 1 && second.Epoch() == third.Epoch());
+
+    return 0;
+}
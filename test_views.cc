@@ -0,0 +1,46 @@
+#include <vector>
+#include "Utils.h"
+#include "priority_queue.h"
+#include "priority_queue_impl.h"
+
+template<typename Impl>
+void TestViews() {
+    PriorityQueue<Impl> queue;
+    for (int i = 0; i < 10; ++i) queue.InsertOrUpdate({i, i % 5});
+    // stale copies, one of which holds the current value again
+    queue.InsertOrUpdate({3, 0});
+    queue.InsertOrUpdate({3, 3});
+
+    std::vector<int> keys;
+    for (const auto &key : queue.KeysView()) keys.push_back(key);
+    Assert (keys == queue.Keys());
+
+    std::vector<std::pair<int, int>> sorted;
+    for (const auto &entry : queue.SortedEntriesView()) sorted.emplace_back(entry.first, entry.second);
+    const std::vector<std::pair<int, int>> expected{{9, 4}, {4, 4}, {8, 3}, {3, 3}, {7, 2}, {2, 2},
+                                                    {6, 1}, {1, 1}, {5, 0}, {0, 0}};
+    Assert (sorted == expected);
+
+    // chunks resume after the last key exported, whatever happened in between
+    ExportCursor<int> cursor;
+    std::vector<int> exported;
+    auto visit = [&](const std::pair<const int, int> &entry) { exported.push_back(entry.first); };
+    Assert (queue.ExportChunk(cursor, 4, visit) == 4 && !cursor.done);
+    queue.Erase(2);     // exported already
+    queue.Erase(5);     // not yet
+    queue.InsertOrUpdate({-1, 7});
+    queue.InsertOrUpdate({20, 7});
+    queue.Pop();
+    Assert (queue.ExportChunk(cursor, 4, visit) == 4 && !cursor.done);
+    Assert (queue.ExportChunk(cursor, 4, visit) == 1 && cursor.done);
+    Assert (queue.ExportChunk(cursor, 4, visit) == 0 && cursor.done);
+    Assert ((exported == std::vector<int>{0, 1, 2, 3, 4, 6, 7, 8, 9}));
+}
+
+int main() {
+    TestViews<PriorityQueueSorted<int, int>>();
+    TestViews<SetSorted<int, int>>();
+    TestViews<BTreeSorted<int, int>>();
+    TestViews<MapSorted<int, int>>();
+    return 0;
+}
@@ -0,0 +1,124 @@
+#ifndef HARA_VIEWS_H
+#define HARA_VIEWS_H
+
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Non-owning range over [first, last), for range-based for loops
+ */
+template<typename Iterator>
+struct View {
+    Iterator first;
+    Iterator last;
+
+    Iterator begin() const { return first; }
+
+    Iterator end() const { return last; }
+};
+
+template<typename Iterator>
+View<Iterator> MakeView(Iterator first, Iterator last) { return View<Iterator>{first, last}; }
+
+namespace views {
+
+/**
+ * The key of an index entry
+ */
+struct First {
+    template<typename Entry>
+    const auto &operator()(const Entry &entry) const { return entry.first; }
+};
+
+/**
+ * The pair held by a PriorityQueueImpl::Pair
+ */
+struct Unwrap {
+    template<typename Pair>
+    const auto &operator()(const Pair &pair) const { return pair.x; }
+};
+
+struct Deref {
+    template<typename T>
+    const T &operator()(const T *pointer) const { return *pointer; }
+};
+
+}
+
+/**
+ * Iterator that yields Project()(*it) in place of *it, without copying
+ */
+template<typename Iterator, typename Project>
+class ProjectIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using reference = decltype(Project()(*std::declval<Iterator>()));
+    using value_type = std::remove_cv_t<std::remove_reference_t<reference>>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::add_pointer_t<std::remove_reference_t<reference>>;
+
+    ProjectIterator() = default;
+
+    explicit ProjectIterator(Iterator it) : it{it} {}
+
+    reference operator*() const { return Project()(*it); }
+
+    pointer operator->() const { return &**this; }
+
+    ProjectIterator &operator++() {
+        ++it;
+        return *this;
+    }
+
+    ProjectIterator operator++(int) {
+        auto copy = *this;
+        ++it;
+        return copy;
+    }
+
+    bool operator==(const ProjectIterator &that) const { return it == that.it; }
+
+    bool operator!=(const ProjectIterator &that) const { return !(*this == that); }
+
+private:
+    Iterator it;
+};
+
+template<typename Project, typename Iterator>
+View<ProjectIterator<Iterator, Project>> MakeProjectView(Iterator first, Iterator last) {
+    return {ProjectIterator<Iterator, Project>{first}, ProjectIterator<Iterator, Project>{last}};
+}
+
+/**
+ * Resumable position of a chunked export in key order.
+ * It only remembers the last key exported, so updates between chunks are fine:
+ * a key present and unchanged throughout the export is visited exactly once,
+ * and a key inserted, updated or erased meanwhile at most once.
+ */
+template<typename K>
+struct ExportCursor {
+    std::optional<K> last;
+    bool done = false;
+};
+
+/**
+ * Visits up to limit entries of an ordered map following cursor, and advances it
+ * Complexity: O(lg(N) + limit)
+ * @return the number of entries visited
+ */
+template<typename Map, typename K, typename Visit>
+size_t ExportChunk(const Map &map, ExportCursor<K> &cursor, size_t limit, Visit &&visit) {
+    auto it = cursor.last ? map.upper_bound(*cursor.last) : map.begin();
+    size_t count = 0;
+    for (; count < limit && it != map.end(); ++it, ++count) {
+        visit(*it);
+        cursor.last = it->first;
+    }
+    cursor.done = it == map.end();
+    return count;
+}
+
+#endif //HARA_VIEWS_H